@@ -0,0 +1,297 @@
+/*****************************************************************************
+ *   adcdma.c:  Burst mode ADC sampling by DMA, with decimation
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * The ADC converts the selected inputs in turn in burst mode. Every
+ * result in the global data register raises a DMA request, and the GPDMA
+ * copies it into one half of a double buffer. Two linked list items point
+ * at each other, so the channel never stops. The CPU is only involved when
+ * a half is full, once per ADCDMA_HALF_LEN conversions. The DMA call-back
+ * sorts that half by input and adds it to the accumulators while the
+ * other half fills.
+ *
+ * Each value is the sum of `decimation` conversions of an input, shifted
+ * to 12 + extraBits bits. Averaging 4^n conversions gives n more bits when
+ * the input has enough noise to dither it.
+ *
+ * NOTE: the ADC interrupt must stay disabled in the NVIC, the ADC then
+ * raises the DMA request instead.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "lpc17xx_adc.h"
+#include "lpc17xx_clkpwr.h"
+#include "lpc17xx_gpdma.h"
+#include "lpc17xx_pinsel.h"
+#include "dma.h"
+#include "adcdma.h"
+
+/******************************************************************************
+ * Defines and typedefs
+ *****************************************************************************/
+
+/* ADC clocks per conversion */
+#define CLOCKS_PER_CONV 65
+
+#define ITEM_CONTROL \
+    (GPDMA_DMACCxControl_TransferSize(ADCDMA_HALF_LEN) \
+    | GPDMA_DMACCxControl_SBSize(GPDMA_BSIZE_1) \
+    | GPDMA_DMACCxControl_DBSize(GPDMA_BSIZE_1) \
+    | GPDMA_DMACCxControl_SWidth(GPDMA_WIDTH_WORD) \
+    | GPDMA_DMACCxControl_DWidth(GPDMA_WIDTH_WORD) \
+    | GPDMA_DMACCxControl_DI \
+    | GPDMA_DMACCxControl_I)
+
+typedef struct
+{
+    uint8_t port;
+    uint8_t pin;
+    uint8_t func;
+} adc_pin_t;
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+/* Pin of each AD0.n input */
+static const adc_pin_t pins[ADCDMA_NUM_INPUTS] = {
+    {0, 23, PINSEL_FUNC_1},
+    {0, 24, PINSEL_FUNC_1},
+    {0, 25, PINSEL_FUNC_1},
+    {0, 26, PINSEL_FUNC_1},
+    {1, 30, PINSEL_FUNC_3},
+    {1, 31, PINSEL_FUNC_3},
+    {0, 3, PINSEL_FUNC_2},
+    {0, 2, PINSEL_FUNC_2}
+};
+
+/* Must follow ADCDMA_CHANNEL */
+static LPC_GPDMACH_TypeDef * const channel = LPC_GPDMACH0;
+
+/* Written by the GPDMA, which also reads the items from RAM */
+static uint32_t buf[2][ADCDMA_HALF_LEN] __attribute__ ((aligned (4)));
+static GPDMA_LLI_Type items[2] __attribute__ ((aligned (4)));
+
+/* Half the GPDMA fills next after the one being processed */
+static uint8_t half = 0;
+
+static uint32_t sum[ADCDMA_NUM_INPUTS];
+static uint16_t count[ADCDMA_NUM_INPUTS];
+static volatile uint32_t value[ADCDMA_NUM_INPUTS];
+static volatile uint8_t valid = 0;
+
+static uint16_t decimation = 1;
+static uint8_t shift = 0;
+static volatile uint32_t overruns = 0;
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+static uint8_t log2Of (uint32_t v)
+{
+    uint8_t n = 0;
+
+    while (v > 1) {
+        v >>= 1;
+        n++;
+    }
+
+    return n;
+}
+
+/* A half of the buffer is full, add it to the accumulators */
+static void halfDone (uint32_t status)
+{
+    const uint32_t *p;
+    uint32_t i;
+    uint32_t gdr;
+    uint8_t ch;
+
+    if (status != GPDMA_STAT_INTTC) {
+        overruns++;
+        return;
+    }
+
+    p = buf[half];
+    half ^= 1;
+
+    for (i = 0; i < ADCDMA_HALF_LEN; i++) {
+        gdr = p[i];
+        ch = ADC_GDR_CH(gdr);
+
+        /* a result overwritten before the DMA read it */
+        if (gdr & ADC_GDR_OVERRUN_FLAG)
+            overruns++;
+
+        sum[ch] += ADC_GDR_RESULT(gdr);
+        if (++count[ch] == decimation) {
+            value[ch] = sum[ch] >> shift;
+            valid |= (1 << ch);
+            sum[ch] = 0;
+            count[ch] = 0;
+        }
+    }
+}
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Configure the inputs and start sampling
+ *
+ * Params:
+ *   [in] cfg - inputs, rate, decimation and extra bits
+ *
+ * Returns:
+ *    0 on success, -1 if the configuration is not valid or the GPDMA
+ *    channel could not be set up
+ *
+ *****************************************************************************/
+int32_t adcdma_init (const adcdma_cfg_t *cfg)
+{
+    GPDMA_Channel_CFG_Type dmaCfg;
+    PINSEL_CFG_Type pinCfg;
+    uint32_t clk;
+    uint8_t decBits;
+    uint8_t i;
+
+    decBits = log2Of(cfg->decimation);
+
+    if (cfg->inputs == 0
+            || cfg->rate < ADCDMA_MIN_RATE || cfg->rate > ADCDMA_MAX_RATE
+            || cfg->decimation == 0 || cfg->decimation > ADCDMA_MAX_DECIMATION
+            || (cfg->decimation & (cfg->decimation - 1)) != 0
+            || cfg->extraBits > decBits / 2)
+        return -1;
+
+    adcdma_stop();
+
+    pinCfg.OpenDrain = PINSEL_PINMODE_NORMAL;
+    pinCfg.Pinmode = PINSEL_PINMODE_TRISTATE;
+    for (i = 0; i < ADCDMA_NUM_INPUTS; i++) {
+        sum[i] = 0;
+        count[i] = 0;
+        if (cfg->inputs & (1 << i)) {
+            pinCfg.Portnum = pins[i].port;
+            pinCfg.Pinnum = pins[i].pin;
+            pinCfg.Funcnum = pins[i].func;
+            PINSEL_ConfigPin(&pinCfg);
+        }
+    }
+
+    decimation = cfg->decimation;
+    shift = decBits - cfg->extraBits;
+    valid = 0;
+    overruns = 0;
+    half = 0;
+
+    /* ADC clock for the rate, 65 clocks per conversion */
+    clk = cfg->rate * CLOCKS_PER_CONV;
+    if (clk > CLKPWR_GetPCLK(CLKPWR_PCLKSEL_ADC))
+        clk = CLKPWR_GetPCLK(CLKPWR_PCLKSEL_ADC);
+    ADC_Init(LPC_ADC, clk);
+    for (i = 0; i < ADCDMA_NUM_INPUTS; i++) {
+        if (cfg->inputs & (1 << i))
+            ADC_ChannelCmd(LPC_ADC, i, ENABLE);
+    }
+
+    /* only the global done flag requests a transfer, the NVIC stays off */
+    LPC_ADC->ADINTEN = ADC_INTEN_GLOBAL;
+    NVIC_DisableIRQ(ADC_IRQn);
+
+    items[0].SrcAddr = (uint32_t)&LPC_ADC->ADGDR;
+    items[0].DstAddr = (uint32_t)buf[0];
+    items[0].NextLLI = (uint32_t)&items[1];
+    items[0].Control = ITEM_CONTROL;
+    items[1].SrcAddr = (uint32_t)&LPC_ADC->ADGDR;
+    items[1].DstAddr = (uint32_t)buf[1];
+    items[1].NextLLI = (uint32_t)&items[0];
+    items[1].Control = ITEM_CONTROL;
+
+    dma_init();
+
+    dmaCfg.ChannelNum = ADCDMA_CHANNEL;
+    dmaCfg.TransferSize = ADCDMA_HALF_LEN;
+    dmaCfg.TransferWidth = 0;
+    dmaCfg.SrcMemAddr = 0;
+    dmaCfg.DstMemAddr = items[0].DstAddr;
+    dmaCfg.TransferType = GPDMA_TRANSFERTYPE_P2M;
+    dmaCfg.SrcConn = GPDMA_CONN_ADC;
+    dmaCfg.DstConn = 0;
+    dmaCfg.DMALLI = items[0].NextLLI;
+
+    if (GPDMA_Setup(&dmaCfg, halfDone) != SUCCESS)
+        return -1;
+
+    /* single word transfers, the ADC has one result to give per request */
+    channel->DMACCControl = items[0].Control;
+
+    GPDMA_ChannelCmd(ADCDMA_CHANNEL, ENABLE);
+    ADC_BurstCmd(LPC_ADC, ENABLE);
+
+    return 0;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Stop sampling and power down the ADC, the last values stay readable
+ *
+ *****************************************************************************/
+void adcdma_stop (void)
+{
+    if (!(LPC_SC->PCONP & CLKPWR_PCONP_PCAD))
+        return;
+
+    ADC_BurstCmd(LPC_ADC, DISABLE);
+    GPDMA_ChannelCmd(ADCDMA_CHANNEL, DISABLE);
+    ADC_DeInit(LPC_ADC);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Get the newest value of an input
+ *
+ * Params:
+ *   [in] input - n for AD0.n
+ *   [out] val - average of the last `decimation` conversions, with
+ *                 12 + extraBits bits
+ *
+ * Returns:
+ *    0 on success, -1 if the input is not sampled or has no value yet
+ *
+ *****************************************************************************/
+int32_t adcdma_getValue (uint8_t input, uint32_t *val)
+{
+    if (input >= ADCDMA_NUM_INPUTS || !(valid & (1 << input)))
+        return -1;
+
+    *val = value[input];
+
+    return 0;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Number of conversions lost since adcdma_init, either overwritten in
+ *    the ADC or lost on a DMA error
+ *
+ *****************************************************************************/
+uint32_t adcdma_getOverrunCount (void)
+{
+    return overruns;
+}
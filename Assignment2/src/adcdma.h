@@ -0,0 +1,50 @@
+/*****************************************************************************
+ *   adcdma.h:  Header file for burst mode ADC sampling by DMA
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __ADCDMA_H
+#define __ADCDMA_H
+
+#include "lpc_types.h"
+
+#define ADCDMA_NUM_INPUTS 8
+
+/* GPDMA channel, the highest priority so the ADC is never overrun */
+#define ADCDMA_CHANNEL 0
+
+/* Conversions in each half of the double buffer */
+#define ADCDMA_HALF_LEN 64
+
+/*
+ * Slowest and fastest total conversion rate, in conversions per second.
+ * A conversion takes 65 ADC clocks, the ADC clock is PCLK divided by
+ * 1 to 256 and at most 13 MHz.
+ */
+#define ADCDMA_MIN_RATE 1600
+#define ADCDMA_MAX_RATE 200000
+
+/* Largest number of conversions averaged into one value, a power of 2 */
+#define ADCDMA_MAX_DECIMATION 4096
+
+typedef struct
+{
+    uint8_t inputs;         /* bit n selects AD0.n */
+    uint32_t rate;          /* conversions per second, all inputs together */
+    uint16_t decimation;    /* conversions of an input per value, power of 2 */
+    uint8_t extraBits;      /* bits kept above 12, at most log2(decimation) / 2 */
+} adcdma_cfg_t;
+
+
+int32_t adcdma_init (const adcdma_cfg_t *cfg);
+void adcdma_stop (void);
+int32_t adcdma_getValue (uint8_t input, uint32_t *val);
+uint32_t adcdma_getOverrunCount (void);
+
+
+#endif /* end __ADCDMA_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
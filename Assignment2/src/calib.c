@@ -0,0 +1,169 @@
+/*****************************************************************************
+ *   calib.c:  Calibration record in the 24LC08 EEPROM
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * NOTE: I2C must have been initialized before calling any functions in this
+ * file.
+ *
+ * The record fills exactly one EEPROM page, so it is loaded with a single
+ * read and saved with a single page write. A save is read back and
+ * checked.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "lpc_types.h"
+#include "eeprom.h"
+#include "telemetry.h"
+#include "modbus.h"
+#include "calib.h"
+
+/******************************************************************************
+ * Defines and typedefs
+ *****************************************************************************/
+
+#define OFS_MAGIC       0
+#define OFS_VERSION     1
+#define OFS_ACC_X       2
+#define OFS_ACC_Y       4
+#define OFS_ACC_Z       6
+#define OFS_LIGHT_GAIN  8
+#define OFS_TEMP_OFFSET 10
+#define OFS_ACC_SAMPLES 12
+#define OFS_MODBUS_ADDR 13
+#define OFS_CRC         14
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+static void put16 (uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static uint16_t get16 (const uint8_t *p)
+{
+    return p[0] | ((uint16_t)p[1] << 8);
+}
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Values to use without a record: no offsets, unit gain and the
+ *    default Modbus address
+ *
+ *****************************************************************************/
+void calib_defaults (calib_t *cal)
+{
+    cal->accX = 0;
+    cal->accY = 0;
+    cal->accZ = 0;
+    cal->lightGain = CALIB_GAIN_ONE;
+    cal->tempOffset = 0;
+    cal->accSamples = 0;
+    cal->modbusAddr = MODBUS_SLAVE_ADDR;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Load the record from the EEPROM
+ *
+ * Params:
+ *   [out] cal - the record, left untouched on failure
+ *
+ * Returns:
+ *    0 on success, -1 if there is no valid record of this version
+ *
+ *****************************************************************************/
+int32_t calib_load (calib_t *cal)
+{
+    uint8_t raw[CALIB_RECORD_LEN];
+    uint8_t addr;
+
+    if (eeprom_read(raw, CALIB_EEPROM_OFFSET, CALIB_RECORD_LEN)
+            != CALIB_RECORD_LEN)
+        return -1;
+
+    if (raw[OFS_MAGIC] != CALIB_MAGIC
+            || (raw[OFS_VERSION] != CALIB_VERSION && raw[OFS_VERSION] != 1)
+            || telemetry_crc16(raw, OFS_CRC) != get16(&raw[OFS_CRC]))
+        return -1;
+
+    /* version 1 had no address, the high byte of its samples is 0 */
+    addr = raw[OFS_MODBUS_ADDR];
+    if (raw[OFS_VERSION] == 1)
+        addr = MODBUS_SLAVE_ADDR;
+    if (addr == 0 || addr > MODBUS_ADDR_MAX)
+        return -1;
+
+    /* the light thresholds are divided by the gain */
+    if (get16(&raw[OFS_LIGHT_GAIN]) == 0)
+        return -1;
+
+    cal->accX = (int16_t)get16(&raw[OFS_ACC_X]);
+    cal->accY = (int16_t)get16(&raw[OFS_ACC_Y]);
+    cal->accZ = (int16_t)get16(&raw[OFS_ACC_Z]);
+    cal->lightGain = get16(&raw[OFS_LIGHT_GAIN]);
+    cal->tempOffset = (int16_t)get16(&raw[OFS_TEMP_OFFSET]);
+    cal->accSamples = raw[OFS_ACC_SAMPLES];
+    cal->modbusAddr = addr;
+
+    return 0;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Write the record to the EEPROM and read it back
+ *
+ * Params:
+ *   [in] cal - the record
+ *
+ * Returns:
+ *    0 on success, -1 if the write failed or did not read back
+ *
+ *****************************************************************************/
+int32_t calib_save (const calib_t *cal)
+{
+    uint8_t raw[CALIB_RECORD_LEN];
+    calib_t check;
+
+    raw[OFS_MAGIC] = CALIB_MAGIC;
+    raw[OFS_VERSION] = CALIB_VERSION;
+    put16(&raw[OFS_ACC_X], (uint16_t)cal->accX);
+    put16(&raw[OFS_ACC_Y], (uint16_t)cal->accY);
+    put16(&raw[OFS_ACC_Z], (uint16_t)cal->accZ);
+    put16(&raw[OFS_LIGHT_GAIN], cal->lightGain);
+    put16(&raw[OFS_TEMP_OFFSET], (uint16_t)cal->tempOffset);
+    raw[OFS_ACC_SAMPLES] = cal->accSamples;
+    raw[OFS_MODBUS_ADDR] = cal->modbusAddr;
+    put16(&raw[OFS_CRC], telemetry_crc16(raw, OFS_CRC));
+
+    if (eeprom_write(raw, CALIB_EEPROM_OFFSET, CALIB_RECORD_LEN)
+            != CALIB_RECORD_LEN)
+        return -1;
+
+    if (calib_load(&check) != 0
+            || check.accX != cal->accX || check.accY != cal->accY
+            || check.accZ != cal->accZ || check.lightGain != cal->lightGain
+            || check.tempOffset != cal->tempOffset
+            || check.accSamples != cal->accSamples
+            || check.modbusAddr != cal->modbusAddr)
+        return -1;
+
+    return 0;
+}
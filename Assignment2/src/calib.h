@@ -0,0 +1,56 @@
+/*****************************************************************************
+ *   calib.h:  Header file for the calibration record in the EEPROM
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __CALIB_H
+#define __CALIB_H
+
+#include "lpc_types.h"
+
+/*
+ * The record is one 16 byte EEPROM page, little endian:
+ *   0      CALIB_MAGIC
+ *   1      CALIB_VERSION
+ *   2..7   accelerometer rest position x, y, z, int16
+ *   8..9   light gain, uint16
+ *   10..11 temperature offset, int16
+ *   12     accelerometer samples averaged, uint8
+ *   13     Modbus slave address, 1 to 247
+ *   14..15 CRC16-CCITT of bytes 0..13, as in telemetry.h
+ * A record with another magic, version or CRC is not used. A version 1
+ * record, with the samples as uint16 in 12..13, is still loaded and gets
+ * the default Modbus address.
+ */
+#define CALIB_EEPROM_OFFSET 0
+#define CALIB_RECORD_LEN    16
+
+#define CALIB_MAGIC         0xCA
+#define CALIB_VERSION       2
+
+/* Unit gain of the light trim */
+#define CALIB_GAIN_ONE      4096
+
+typedef struct
+{
+    int16_t accX;           /* rest position, 1/16 count of the 2g output */
+    int16_t accY;
+    int16_t accZ;
+    uint16_t lightGain;     /* light reading scale, CALIB_GAIN_ONE is 1.0 */
+    int16_t tempOffset;     /* added to the temperature, 0.1 C */
+    uint8_t accSamples;     /* samples averaged for the rest position */
+    uint8_t modbusAddr;     /* Modbus slave address, 1 to 247 */
+} calib_t;
+
+
+void calib_defaults (calib_t *cal);
+int32_t calib_load (calib_t *cal);
+int32_t calib_save (const calib_t *cal);
+
+
+#endif /* end __CALIB_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
@@ -0,0 +1,60 @@
+/*****************************************************************************
+ *   dma.c:  Shared GPDMA controller set-up and interrupt
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * Several modules use their own GPDMA channels. The controller is powered
+ * up and reset only once, by the first of them, and the interrupt is
+ * dispatched by the GPDMA driver to the call-back of each channel.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "lpc17xx_gpdma.h"
+#include "dma.h"
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+static uint8_t dmaReady = 0;
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Power up the GPDMA controller and enable its interrupt. Only the
+ *    first call does anything, later ones must not reset the channels
+ *    already running.
+ *
+ *****************************************************************************/
+void dma_init (void)
+{
+    if (dmaReady)
+        return;
+
+    GPDMA_Init();
+    NVIC_ClearPendingIRQ(DMA_IRQn);
+    NVIC_EnableIRQ(DMA_IRQn);
+    dmaReady = 1;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    GPDMA interrupt, dispatched by the GPDMA driver to the call-backs
+ *
+ *****************************************************************************/
+void DMA_IRQHandler (void)
+{
+    GPDMA_IntHandler();
+}
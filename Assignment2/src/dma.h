@@ -0,0 +1,26 @@
+/*****************************************************************************
+ *   dma.h:  Header file for the shared GPDMA controller set-up
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __DMA_H
+#define __DMA_H
+
+#include "lpc_types.h"
+
+/*
+ * GPDMA channels in use, lower numbers have the higher priority:
+ *   0     - ADC sampling, see adcdma.h
+ *   4..7  - UART transmit, see uartdma.h
+ */
+
+
+void dma_init (void);
+
+
+#endif /* end __DMA_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
@@ -0,0 +1,122 @@
+/*****************************************************************************
+ *   event.c:  Event bits posted by interrupts to the main loop
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * Interrupt handlers post EV_x bits, the main loop takes them all at once
+ * and runs the handlers for the bits that are set. With nothing pending
+ * event_wait() puts the core to sleep until the next interrupt.
+ *
+ * The check for pending events and the WFI are done with interrupts
+ * masked. An interrupt that arrives between the two still wakes the core,
+ * as WFI returns on a pending interrupt whatever PRIMASK is, so no event
+ * is left waiting for the one after it. The handler runs as soon as the
+ * mask is lifted.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "LPC17xx.h"
+#include "event.h"
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+static volatile uint32_t pending = 0;
+static uint32_t wakeCount = 0;
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Post events, from an interrupt handler or the main loop
+ *
+ * Params:
+ *   [in] events - EV_x bits
+ *
+ *****************************************************************************/
+void event_post (uint32_t events)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    /* a higher priority handler may post in between the read and write */
+    __disable_irq();
+    pending |= events;
+    __set_PRIMASK(primask);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Take the pending events without waiting
+ *
+ * Returns:
+ *    EV_x bits posted since the last call, 0 if none
+ *
+ *****************************************************************************/
+uint32_t event_take (void)
+{
+    uint32_t events;
+
+    __disable_irq();
+    events = pending;
+    pending = 0;
+    __enable_irq();
+
+    return events;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Take the pending events, sleeping until there is one. Call it from
+ *    the main loop only.
+ *
+ * Returns:
+ *    EV_x bits posted since the last call, never 0
+ *
+ *****************************************************************************/
+uint32_t event_wait (void)
+{
+    uint32_t events;
+
+    while (1) {
+        __disable_irq();
+        events = pending;
+        pending = 0;
+        if (events == 0) {
+            /* sleep mode, the peripherals keep running */
+            SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+            __WFI();
+        }
+        __enable_irq();
+
+        if (events != 0) {
+            wakeCount++;
+            return events;
+        }
+    }
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Number of times event_wait() returned with events. Each costs one
+ *    pass through the handlers, so this is a measure of the CPU load. A
+ *    wake for an interrupt that posts nothing is not counted.
+ *
+ *****************************************************************************/
+uint32_t event_getWakeCount (void)
+{
+    return wakeCount;
+}
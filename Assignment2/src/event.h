@@ -0,0 +1,32 @@
+/*****************************************************************************
+ *   event.h:  Header file for the event bits posted to the main loop
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __EVENT_H
+#define __EVENT_H
+
+#include "lpc_types.h"
+
+#define EV_TICK     0x01    /* a sensor read or a sleeping task is due */
+#define EV_SECOND   0x02    /* one second of the 7 segment count */
+#define EV_BUTTON   0x04    /* SW4 pressed */
+#define EV_LIGHT    0x08    /* light threshold crossed */
+#define EV_TEMP     0x10    /* temperature reading ready */
+#define EV_UART_RX  0x20    /* bytes received on the terminal */
+#define EV_MOTION   0x40    /* movement detected by the accelerometer */
+#define EV_DUMP     0x80    /* DMA dump of the sample history done */
+
+
+void event_post (uint32_t events);
+uint32_t event_take (void);
+uint32_t event_wait (void);
+uint32_t event_getWakeCount (void);
+
+
+#endif /* end __EVENT_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
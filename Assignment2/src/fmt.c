@@ -0,0 +1,154 @@
+/*****************************************************************************
+ *   fmt.c:  Integer only string formatting
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * Replaces sprintf for the few formats the application needs. Nothing
+ * here touches floating point, so newlib's printf and the soft-float
+ * library are not linked in. Fixed point values are scaled integers,
+ * e.g. a temperature of 25.3 C is passed as 253 with one decimal.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "fmt.h"
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+/* Write the digits of value, at least minDigits of them, most significant first */
+static uint32_t putDigits (char *buf, uint32_t value, uint8_t minDigits)
+{
+    char tmp[10];
+    uint32_t n = 0;
+    uint32_t i;
+
+    do {
+        tmp[n++] = '0' + (value % 10);
+        value /= 10;
+    } while (value != 0 && n < sizeof(tmp));
+
+    while (n < minDigits && n < sizeof(tmp))
+        tmp[n++] = '0';
+
+    for (i = 0; i < n; i++)
+        buf[i] = tmp[n - 1 - i];
+    buf[n] = '\0';
+
+    return n;
+}
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Copy a string
+ *
+ *****************************************************************************/
+uint32_t fmt_string (char *buf, const char *str)
+{
+    uint32_t n = 0;
+
+    while (str[n] != '\0') {
+        buf[n] = str[n];
+        n++;
+    }
+    buf[n] = '\0';
+
+    return n;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Format an unsigned value, zero padded to at least minDigits (as %0Nu)
+ *
+ *****************************************************************************/
+uint32_t fmt_uint (char *buf, uint32_t value, uint8_t minDigits)
+{
+    return putDigits(buf, value, minDigits);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Format a signed value (as %d)
+ *
+ *****************************************************************************/
+uint32_t fmt_int (char *buf, int32_t value)
+{
+    if (value < 0) {
+        buf[0] = '-';
+        /* negate as unsigned so INT32_MIN does not overflow */
+        return 1 + putDigits(buf + 1, 0u - (uint32_t)value, 1);
+    }
+
+    return putDigits(buf, (uint32_t)value, 1);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Format a fixed point value
+ *
+ * Params:
+ *   [out] buf - at least FMT_INT_MAX_LEN + 2 characters
+ *   [in] value - value scaled by 10^decimals
+ *   [in] decimals - number of digits after the decimal point, 0..9
+ *
+ *****************************************************************************/
+uint32_t fmt_fixed (char *buf, int32_t value, uint8_t decimals)
+{
+    uint32_t mag;
+    uint32_t scale = 1;
+    uint32_t n = 0;
+    uint8_t i;
+
+    if (decimals == 0)
+        return fmt_int(buf, value);
+
+    for (i = 0; i < decimals; i++)
+        scale *= 10;
+
+    if (value < 0) {
+        buf[n++] = '-';
+        mag = 0u - (uint32_t)value;
+    } else {
+        mag = (uint32_t)value;
+    }
+
+    n += putDigits(buf + n, mag / scale, 1);
+    buf[n++] = '.';
+    n += putDigits(buf + n, mag % scale, decimals);
+
+    return n;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Left justify the len characters in buf by appending spaces up to
+ *    width (as %-Nx). Nothing is cut if the text is already wider.
+ *
+ * Returns:
+ *    New length of the string in buf
+ *
+ *****************************************************************************/
+uint32_t fmt_padRight (char *buf, uint32_t len, uint32_t width)
+{
+    while (len < width)
+        buf[len++] = ' ';
+    buf[len] = '\0';
+
+    return len;
+}
@@ -0,0 +1,33 @@
+/*****************************************************************************
+ *   fmt.h:  Header file for the integer only string formatting
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __FMT_H
+#define __FMT_H
+
+#include "lpc_types.h"
+
+/*
+ * All functions write into a caller supplied buffer, terminate it with
+ * '\0' and return the number of characters written without the '\0'.
+ * Calls are chained by passing buf + the returned length.
+ */
+
+/* Characters needed for any int32_t, sign included, without the '\0' */
+#define FMT_INT_MAX_LEN 11
+
+
+uint32_t fmt_string (char *buf, const char *str);
+uint32_t fmt_uint (char *buf, uint32_t value, uint8_t minDigits);
+uint32_t fmt_int (char *buf, int32_t value);
+uint32_t fmt_fixed (char *buf, int32_t value, uint8_t decimals);
+uint32_t fmt_padRight (char *buf, uint32_t len, uint32_t width);
+
+
+#endif /* end __FMT_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
@@ -9,6 +9,7 @@
 /**
  * Import Libraries from LPC17
  */
+#include "lpc17xx_clkpwr.h"
 #include "lpc17xx_pinsel.h"
 #include "lpc17xx_gpio.h"
 #include "lpc17xx_i2c.h"
@@ -26,27 +27,70 @@
 #include "rgb.h"
 #include "led7seg.h"
 #include "light.h"
+#include "temp.h"
+
+/**
+ * Import Libraries from Application
+ */
+#include "adcdma.h"
+#include "calib.h"
+#include "event.h"
+#include "fmt.h"
+#include "modbus.h"
+#include "motion.h"
+#include "regmap.h"
+#include "sensor.h"
+#include "shell.h"
+#include "swtimer.h"
+#include "task.h"
+#include "telemetry.h"
+#include "uart.h"
+#include "uartdma.h"
 
 /**
  * Import Libraries from C
  */
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 /**
  * Define Constants
  */
-#define LIGHT_LOW_WARNING 50 // In Lux
-#define TEMP_HIGH_WARNING 26 // In Celcius
+#define LIGHT_LOW_WARNING 50 // In Lux, default until changed from the shell
+#define TEMP_HIGH_WARNING 26 // In Celcius, default until changed from the shell
+#define SAMPLE_INTERVAL 5	 // In Seconds, default until changed from the shell
+#define BLINK_PERIOD 333	 // In ms, the RGB blinks with a warning
+#define DELTA_KEY_INTERVAL 16 // Records from one keyframe to the next in the delta format
+#define TEMP_FAST_BAND 20	 // In 0.1 Celcius, fast temperature readings this close to the warning
+#define ACC_BATCH 16		 // Accelerometer samples taken from the ring at a time
+#define ACC_READ_PERIOD 100	 // In ms, the ring is drained this often, about 12 samples at 125 Hz
+#define TEMP_READ_PERIOD 50	 // In ms, the temperature driver is polled this often
+#ifdef TEMP_USE_CAP3_0
+#define ADC_INPUTS ((1 << 1) | (1 << 2)) // AD0.1 and AD0.2 on P0.24/P0.25, P0.23 is the temperature counter input
+#else
+#define ADC_INPUTS ((1 << 0) | (1 << 1) | (1 << 2)) // AD0.0 (trimpot) on P0.23, AD0.1 and AD0.2 on P0.24/P0.25
+#endif
+#define ADC_RATE 1600		 // ADC conversions per second, all inputs together
+#define ACC_CAL_SAMPLES 64	 // Accelerometer readings averaged for the rest position, 8 ms apart
+#define ADC_DECIMATION 256	 // Conversions averaged per value, about 0.5 s with three inputs
+#define ADC_EXTRA_BITS 4	 // 16 bit values
+#define MOVEMENT_THRESHOLD_MG 156 // 10 counts of the 2g output, used by the sensor's motion detection
+#define SHOCK_LEVEL_MG 2500	 // Peak on any axis counted as a shock, the movement detector's samples clip at 2 g
+#define HISTORY_SIZE 2048	 // Bytes of binary frames kept for the dump command, a power of two
+#define DUMP_UART 3			 // The terminal, UART3
 
 /**
  * Define the Limits
  */
-const uint32_t interruptDarkLowerLimit = LIGHT_LOW_WARNING;		// Interrupt to occur when below this warning
+uint32_t interruptDarkLowerLimit = LIGHT_LOW_WARNING;			// Interrupt to occur when below this warning
 const uint32_t interruptDarkUpperLimit = 3891;					// In accordance to the data sheet
 const uint32_t interruptLightLowerLimit = 0;
-const uint32_t interruptLightUpperLimit = LIGHT_LOW_WARNING - 1;// Interrupt to occur when above this warning
+uint32_t interruptLightUpperLimit = LIGHT_LOW_WARNING - 1;		// Interrupt to occur when above this warning
+int32_t tempHighWarning = TEMP_HIGH_WARNING*10;					// In 0.1 Celcius
+
+// Temperature conversion profiles, indexed by temp_profile_t
+const char *tempProfileNames[TEMP_NUM_PROFILES] = {"fast", "normal", "precise"};
+int tempProfileAuto = 1;
 
 /**
  * Define the two different types of mode
@@ -55,6 +99,21 @@ typedef enum{
 	MODE_STABLE, MODE_MONITOR
 } system_mode;
 
+/**
+ * Define the formats of the sensor values sent on the UART
+ */
+typedef enum{
+	FORMAT_TEXT, FORMAT_BINARY, FORMAT_DELTA
+} telemetry_format;
+
+/**
+ * Define where movement is detected: by filtering the samples here, or by
+ * the accelerometer's level and pulse detection
+ */
+typedef enum{
+	MOTION_SAMPLES, MOTION_SENSOR
+} motion_source;
+
 /**
  * Define the 4 types of warnings
  */
@@ -67,14 +126,12 @@ typedef enum{
 volatile system_mode mode = MODE_STABLE;
 volatile warning_issued warning;
 uint32_t msTicks = 0;
-uint8_t isFirstTimeEnterStable = 1;
-uint8_t isFirstTimeEnterMonitor = 1;
+volatile uint32_t tickAt = 0;	// ms tick to post EV_TICK at
+volatile uint8_t tickArmed = 0;	// a sensor read or a sleeping task is due at tickAt
+int monitoring = 0;	// the operations of MONITOR mode are on
 
 // Light Interrupts
-int lightLowWarning = 0;
-
-// Timer Interrupt
-int oneSecondHasReached = 0;
+volatile int lightLowWarning = 0;	// flipped by the light interrupt
 
 // RGB
 uint8_t RGB_RED_AND_BLUE = 0x03;
@@ -82,11 +139,11 @@ int onOrOff = 1;
 
 // 7 Segment
 int segCount = 0;
+int sampleInterval = SAMPLE_INTERVAL;
 const char displayValues[] = "0123456789ABCDEF";
 
 // SwitchButton 4
 uint8_t sw4 = 0;
-uint32_t sw4PressTicks;
 
 // Initialize OLED
 char OLED_TEMPERATURE[15];
@@ -106,6 +163,20 @@ int8_t prevX = 0;
 int8_t prevY = 0;
 int8_t prevZ = 0;
 int isThereMovement = 0;
+int movementSeen = 0;	// set when any sample since the last check moved
+uint32_t shockCount = 0;	// drains with a peak over SHOCK_LEVEL_MG
+int32_t shockPeakMg = 0;	// largest peak since the last acc command, in mg
+motion_source motionSource = MOTION_SAMPLES;
+motion_state_t motionDetector;
+acc_sample_t accRest;	// sensor output at start up, the rest position
+
+// Calibration, loaded from the EEPROM at start up
+calib_t calibration;
+
+// Sensor ids in the registry
+int32_t tempSensor = -1;
+int32_t lightSensor = -1;
+int32_t accSensor = -1;
 
 // UART
 const char messageEnterMonitor[] = "Entering MONITOR mode.\r\n";
@@ -113,16 +184,37 @@ unsigned char displayValuesToUART[100] = "";
 unsigned char displayHighTempWarning[] = "Fire was Detected.\r\n";
 unsigned char displayMovementInLowLight[] = "Movement in Darkness was Detected.\r\n";
 int message = 0;
+telemetry_format telemetryFormat = FORMAT_TEXT;
+telemetry_delta_t deltaEncoder;
+uint8_t telemetryFrame[TELEMETRY_DELTA_FRAME_MAX];	// Large enough for both binary formats
+
+// Sample history, the newest fixed binary frames back to back, oldest first
+uint8_t history[HISTORY_SIZE];
+uint32_t historyHead = 0;		// where the next frame goes
+uint32_t historyLen = 0;		// bytes held, always whole frames
+uartdma_buf_t dumpChain[2];		// the history up to the end of the buffer and from its start
+volatile uint8_t dumping = 0;	// the GPDMA is sending the history
+
+// Software timers, see swtimer.h
+swtimer_t secondTimer;	// counts the 7 Segment, MONITOR mode only
+swtimer_t blinkTimer;	// blinks the RGB while there is a warning
+
+// Tasks, see task.h
+task_t buttonTask;
+task_t shellTask;
+task_t modeTask;
+task_t sensorTask;
+task_t lightTask;
+task_t warningTask;
+task_t telemetryTask;
+task_t displayTask;
+task_t dumpTask;
+uint8_t displayDue = 0;	// a light sample came in, show the sensors
 
 // Light and Temperature Values
 uint32_t light = 0;
 volatile uint32_t temperature = 0;
 
-// Temperature Variables
-uint8_t tempState = 0;
-uint32_t temp1 = 0;
-uint32_t temp2 = 0;
-
 /***** End of Variables *****/
 
 /**
@@ -185,10 +277,16 @@ void init_uart(void){
     uartCfg.Stopbits = UART_STOPBIT_1;
     //pin select for uart3;
     pinsel_uart3();
+    //uart3 clock at CCLK, needed for 921600 and 1M baud
+    CLKPWR_SetPCLKDiv(CLKPWR_PCLKSEL_UART3, CLKPWR_PCLKSEL_CCLK_DIV_1);
     //supply power & setup working parameters for uart3
     UART_Init(LPC_UART3, &uartCfg);
     //enable transmit for uart3
     UART_TxCmd(LPC_UART3, ENABLE);
+    //send through the interrupt driven transmit buffer
+    uart_init();
+    //the dump command sends by DMA, see uart_beginTxDma
+    uartdma_init(DUMP_UART);
 }
 
 /**
@@ -265,13 +363,22 @@ static void init_GPIO(void){
 	GPIO_SetDir(1, 1<<31, 0);
 }
 
+/**
+ * Set the light interrupt thresholds, in calibrated lux
+ * The sensor compares its own reading, so undo the gain first
+ */
+void setLightLimits(uint32_t lo, uint32_t hi){
+	light_setLoThreshold((lo << 12) / calibration.lightGain);
+	light_setHiThreshold((hi << 12) / calibration.lightGain);
+}
+
 /**
  * Function to initialize the light interrupt
  */
 void init_lightInterrupt(){
     light_setRange(LIGHT_RANGE_4000);				// In accordance to data sheet
-	light_setLoThreshold(interruptDarkLowerLimit);	// Will interrupt below this threshold
-	light_setHiThreshold(interruptDarkUpperLimit);	// Will interrupt above this threshold
+	light_setAutoRange(TRUE);						// Start at 4000 lux, step with the readings
+	setLightLimits(interruptDarkLowerLimit, interruptDarkUpperLimit);	// Will interrupt outside these thresholds
 	light_setIrqInCycles(LIGHT_CYCLE_1);			// Number of cycles before the interrupt kicks in
 	light_clearIrqStatus();							// Clear the Interrupt Status
 	LPC_GPIOINT->IO2IntClr = 1 << 5;				// Clear the interrupt flag of a pin
@@ -281,19 +388,69 @@ void init_lightInterrupt(){
 	NVIC_EnableIRQ(EINT3_IRQn);						// Enable the interrupt
 }
 
+/**
+ * Function to start sampling the analog inputs
+ * The ADC runs in burst mode and the values are averaged by DMA, no interrupt per conversion
+ */
+void init_adc(){
+	adcdma_cfg_t cfg;
+
+	cfg.inputs = ADC_INPUTS;
+	cfg.rate = ADC_RATE;
+	cfg.decimation = ADC_DECIMATION;
+	cfg.extraBits = ADC_EXTRA_BITS;
+	adcdma_init(&cfg);
+}
+
+/**
+ * Function to get the tick count
+ */
+uint32_t getTicks() {
+    return msTicks;
+}
+
+/**
+ * Function to check if switch 4 is pressed
+ * Called from the tick, port 1 has no pin interrupts
+ * The button task de-bounces it
+ */
+int isSwitch4Pressed(){
+	// Read the switch
+	sw4 = (GPIO_ReadValue(1) >> 31) & 0x01;
+	return sw4 == 0;
+}
+
 /**
  * Function of Tick Handler
  * Increase tick count by 1 every millisecond
+ * Wakes the main loop when the timed work is due and for the switch
  */
 void SysTick_Handler(void) {
     msTicks++;
+    acc_drdy();		// Picks up a sample deferred while I2C was busy
+    acc_motionEvent();
+
+    // The tick wraps, compare the difference
+    if(tickArmed && (int32_t)(msTicks - tickAt) >= 0){
+    	tickArmed = 0;
+    	event_post(EV_TICK);
+    }
+    if(isSwitch4Pressed())
+    	event_post(EV_BUTTON);
 }
 
 /**
- * Function to get the tick count
+ * Wake the main loop for a temperature reading, runs in interrupt context
  */
-uint32_t getTicks() {
-    return msTicks;
+void postTempReady(){
+	event_post(EV_TEMP);
+}
+
+/**
+ * Wake the main loop for received bytes, runs in interrupt context
+ */
+void postUartRx(){
+	event_post(EV_UART_RX);
 }
 
 /**
@@ -307,6 +464,14 @@ void change7Seg(){
 		segCount++;
 }
 
+/**
+ * Call-back of the one second timer, runs in interrupt context
+ */
+void onSecond(){
+	change7Seg();				// Change the 7 Segment
+	event_post(EV_SECOND);		// Wake the main loop
+}
+
 /**
  * Function run the blinking of RGB
  */
@@ -316,119 +481,112 @@ void runBlinkRGB(uint8_t colour){
 
 /**
  * Function to flip the limits of the Light Sensor
+ * Uses I2C2, so it runs in the main loop, never in the interrupt
  */
 void flipLightLimits(){
 	if(lightLowWarning == 1){
 		// Set the interrupt to occur again when light level is high
-		light_setLoThreshold(interruptLightLowerLimit);
-		light_setHiThreshold(interruptLightUpperLimit);
+		setLightLimits(interruptLightLowerLimit, interruptLightUpperLimit);
 	} else {
 		// Set the interrupt to occur again when light level is low
-		light_setLoThreshold(interruptDarkLowerLimit);
-		light_setHiThreshold(interruptDarkUpperLimit);
+		setLightLimits(interruptDarkLowerLimit, interruptDarkUpperLimit);
 	}
 	// Clear the interrupt status so that it can occur again
 	light_clearIrqStatus();
 }
 
 /**
- * Function to obtain the Prescalar value from the given timer Peripheral Clock Bit
- * Credits given to: https://exploreembedded.com/wiki/LPC1768:_Timers
+ * Function to change the mode of the LPC
  */
-unsigned int getPrescalar(uint8_t timerPeripheralClockBit){
-    unsigned int peripheralClock, prescalar;
-
-    // get the peripheral clock info for required timer
-    if(timerPeripheralClockBit < 10)
-    	peripheralClock = (LPC_SC->PCLKSEL0 >> timerPeripheralClockBit) & 0x03;
-    else
-    	peripheralClock = (LPC_SC->PCLKSEL1 >> timerPeripheralClockBit) & 0x03;
-
-    // Decode the bits to determine the peripheral clock, obtained from the LPC Timer
-    switch ( peripheralClock ){
-		case 0x00:
-			peripheralClock = SystemCoreClock/4;
-			break;
-
-		case 0x01:
-			peripheralClock = SystemCoreClock;
-			break;
-
-		case 0x02:
-			peripheralClock = SystemCoreClock/2;
-			break;
-
-		case 0x03:
-			peripheralClock = SystemCoreClock/8;
-			break;
-    }
-
-    // Prescalar for 1us (1000000Counts/sec)
-    prescalar = peripheralClock/1000000 - 1;
-
-    return prescalar;
+void changeMode(){
+	if(mode == MODE_STABLE){
+		mode = MODE_MONITOR;
+	}else{
+		mode = MODE_STABLE;
+	}
 }
 
 /**
- * Function to initialize the timer1 Interrupt
- * timer1 will run at every 1 second interval
+ * Read hook of the accelerometer sensor, only runs with MOTION_SAMPLES
+ * Drains the samples taken on data ready since the last call, the raw
+ * values are the newest one. Every sample goes through the movement
+ * detector so a movement between two calls is not missed. The samples
+ * clip at 2 g, so a shock is found from the driver's 10 bit peak instead
+ * and also counts as a movement.
+ * Returns 0 if there is no sample, the previous values are then kept
  */
-void init_timer1Interrupt(){
-	LPC_SC->PCONP |= (1 << 2);			// Power Up Timer 1
-	LPC_SC->PCLKSEL0 |= 0x01 << 4;		// Select the Timer 1 pin
-    LPC_TIM1->MCR  = (1<<0) | (1<<1);	// Clear Timer Counter on Match Register 0 match and Generate Interrupt
-    LPC_TIM1->PR   = getPrescalar(4);	// Prescalar for 1us
-    LPC_TIM1->MR0  = 1000000;   		// Load timer value to generate 1s delay
-    LPC_TIM1->TCR  = (1 << 0);			// Start timer by setting the Counter Enable
+uint8_t readAccSensor(int32_t *raw){
+	acc_sample_t batch[ACC_BATCH];
+	uint32_t n;
+	int32_t peakMg;
+	uint8_t found = 0;
+
+	while((n = acc_getSamples(batch, ACC_BATCH)) > 0){
+		if(motion_process(&motionDetector, batch, n) > 0)
+			movementSeen = 1;
+		raw[0] = batch[n-1].x;
+		raw[1] = batch[n-1].y;
+		raw[2] = batch[n-1].z;
+		found = 3;
+	}
+
+	peakMg = ACC_10BIT_TO_MG(acc_takePeak());
+	if(peakMg >= SHOCK_LEVEL_MG){
+		shockCount++;
+		movementSeen = 1;
+	}
+	if(peakMg > shockPeakMg)
+		shockPeakMg = peakMg;
+
+	return found;
 }
 
 /**
- * Function to initialize the timer2 Interrupt
- * timer 2 will run at every 0.333333 second interval
+ * Start hook of the accelerometer sensor, sample on data ready
  */
-void init_timer2Interrupt(){
-    LPC_SC->PCONP |= (1 << 22);			// Power Up Timer 2
-    LPC_SC->PCLKSEL1 |= 0x01 << 12;		// Select the Timer 2 pin
-    LPC_TIM2->MCR  = (1<<0) | (1<<1);	// Clear Timer Counter on Match Register 0 match and Generate Interrupt
-    LPC_TIM2->PR   = getPrescalar(12);	// Prescalar for 1us
-    LPC_TIM2->MR0  = 333333;   			// Load timer value to generate 1s delay
-    LPC_TIM2->TCR  = (1 << 0);			// Start timer by setting the Counter Enable
+void startAccSensor(){
+	if(motionSource == MOTION_SENSOR)
+		return;
+
+	motion_init(&motionDetector, MOTION_ON_LEVEL, MOTION_OFF_LEVEL);
+	acc_startSampling();
 }
 
 /**
- * Function to check if switch 4 is pressed
+ * Convert hook of the accelerometer sensor, relative to the rest position
  */
-int isSwitch4Pressed(){
-	// Read the switch
-	sw4 = (GPIO_ReadValue(1) >> 31) & 0x01;
-	// De-bounce the switch to determined if it is press
-	if((sw4 == 0) && (getTicks()- sw4PressTicks >= 500)){
-		sw4PressTicks = getTicks();
-		return 1;
-	} else {
-		return 0;
-	}
+void convertAcc(int32_t *value, uint8_t count){
+	value[0] += xoff;
+	value[1] += yoff;
+	value[2] += zoff;
 }
 
 /**
- * Function to change the mode of the LPC
+ * Take a sample of the accelerometer
  */
-void changeMode(){
-	if(mode == MODE_STABLE){
-		mode = MODE_MONITOR;
-	}else{
-		mode = MODE_STABLE;
-	}
+void takeAcc(const sensor_sample_t *sample){
+	x = sample->value[0];
+	y = sample->value[1];
+	z = sample->value[2];
 }
 
 /**
- * Function to read the accelerometer
+ * Read the current accelerometer values while the sensor detects movement
+ * Nothing is polled then, the values are only read when they are shown
+ * or sent
  */
-void readAccelerometer(){
-	acc_read(&x, &y, &z);
-	x = x + xoff;
-	y = y + yoff;
-	z = z + zoff;
+void readAccelerometerOnDemand(){
+	int8_t rx, ry, rz;
+
+	if(motionSource != MOTION_SENSOR)
+		return;
+
+	if(acc_readLatest(&rx, &ry, &rz) != 0)
+		return;
+
+	x = rx + xoff;
+	y = ry + yoff;
+	z = rz + zoff;
 }
 
 /**
@@ -442,24 +600,89 @@ void storePreviousAccelerometerValues(){
 
 /**
  * Set the current position of the accelerometer to Zero-G
- * Only done during start up to determine the orientation of the board
+ * The rest position comes from the calibration record
  * From there it will read the offset
  */
 void setAccelerometerAtZeroG(){
-    acc_read(&x, &y, &z);
-    xoff = 0-x;
-    yoff = 0-y;
-    zoff = 0-z;
+    accRest.x = (calibration.accX + 8) >> 4;
+    accRest.y = (calibration.accY + 8) >> 4;
+    accRest.z = (calibration.accZ + 8) >> 4;
+    accRest.pad = 0;
+    xoff = 0-accRest.x;
+    yoff = 0-accRest.y;
+    zoff = 0-accRest.z;
+}
+
+/**
+ * Average the accelerometer at rest into the calibration, in 1/16 counts
+ * Polls the sensor, so sampling must be stopped
+ * Returns 0 on success, -1 if the sensor could not be read
+ */
+int calibrateAccelerometer(){
+	int32_t sumX = 0, sumY = 0, sumZ = 0;
+	int16_t ax, ay, az;
+	uint32_t start;
+	int i;
+
+	for(i = 0; i < ACC_CAL_SAMPLES; i++){
+		// One new output per sample at 125 Hz
+		start = getTicks();
+		while(getTicks() - start < 8);
+		// The 10 bit outputs are 1/64 g at any range, a count of the 2g output
+		if(acc_read10(&ax, &ay, &az) != 0)
+			return -1;
+		sumX += ax;
+		sumY += ay;
+		sumZ += az;
+	}
+
+	calibration.accX = (sumX * 16) / ACC_CAL_SAMPLES;
+	calibration.accY = (sumY * 16) / ACC_CAL_SAMPLES;
+	calibration.accZ = (sumZ * 16) / ACC_CAL_SAMPLES;
+	calibration.accSamples = ACC_CAL_SAMPLES;
+	return 0;
+}
+
+/**
+ * Load the calibration record, the defaults are used if there is none
+ * The light thresholds depend on it, so load it before they are set
+ */
+void loadCalibration(){
+	if(calib_load(&calibration) != 0)
+		calib_defaults(&calibration);
+}
+
+/**
+ * Start finding movement with the selected source, only in MONITOR mode
+ */
+void startMotion(){
+	if(!monitoring)
+		return;
+
+	if(motionSource == MOTION_SENSOR)
+		acc_startMotionDetect(MOVEMENT_THRESHOLD_MG, &accRest);
+	else
+		sensor_start(accSensor, getTicks());
+}
+
+/**
+ * Stop finding movement, nothing is read from the accelerometer after this
+ */
+void stopMotion(){
+	if(motionSource == MOTION_SENSOR){
+		acc_stopMotionDetect();
+	} else {
+		sensor_stop(accSensor);
+	}
 }
 
 /**
  * Function to disable all the interrupts
  */
 void disableAllInterrupts(){
-	light_setLoThreshold(interruptDarkLowerLimit);
-	light_setHiThreshold(interruptDarkUpperLimit);
-    NVIC_DisableIRQ(TIMER1_IRQn);
-    NVIC_DisableIRQ(TIMER2_IRQn);
+	setLightLimits(interruptDarkLowerLimit, interruptDarkUpperLimit);
+    swtimer_stop(&secondTimer);
+    swtimer_stop(&blinkTimer);
     NVIC_DisableIRQ(EINT3_IRQn);
 }
 
@@ -470,6 +693,10 @@ void disableAllInterrupts(){
 void turnOffAllOperations(){
 	// Disable Interrupts
 	disableAllInterrupts();
+	sensor_stop(lightSensor);
+	sensor_stop(tempSensor);
+	stopMotion();
+	monitoring = 0;
 
 	// Reset the flags
 	lightLowWarning = 0;
@@ -490,12 +717,6 @@ void turnOffAllOperations(){
 
 	// Set Warning to none
 	warning = NONE;
-
-	// Indicate that the screen is cleared
-	isFirstTimeEnterStable = 0;
-
-	// Change the flag to display monitor mode at UART
-	isFirstTimeEnterMonitor = 1;
 }
 
 /**
@@ -505,58 +726,59 @@ void enableAllOperations(){
 	// Display monitor on the OLED
 	oled_putString(0,  0, (uint8_t*) "    MONITOR    ", OLED_COLOR_WHITE, OLED_COLOR_BLACK);
 
-	// Read and store accelerometer value
-	readAccelerometer();
+	// Sample the light and temperature from now, store accelerometer value
+	sensor_start(lightSensor, getTicks());
+	sensor_start(tempSensor, getTicks());
 	storePreviousAccelerometerValues();
+	monitoring = 1;
+	startMotion();
+	movementSeen = 0;
+	acc_getMotion();
 
-	// Enable Timer Interrupt
-	NVIC_EnableIRQ(TIMER1_IRQn);
+	// Start the one second timer
+	swtimer_start(&secondTimer, 1000, 1000, onSecond);
 	NVIC_EnableIRQ(EINT3_IRQn);
 	light_clearIrqStatus();
 
 	// Send message to UART
-	UART_Send(LPC_UART3, (uint8_t *) messageEnterMonitor, strlen(messageEnterMonitor), BLOCKING);
-
-	// Change Flag
-	isFirstTimeEnterMonitor = 0;
-
-	// Flag to set clearScreen when change mode
-	isFirstTimeEnterStable = 1;
+	uart_write((uint8_t *) messageEnterMonitor, strlen(messageEnterMonitor));
 }
 
 /**
  * Check the accelerometer to see if there is movement
- * A movement is considered to be of a value more than 10 in one direction
+ * A movement is when the detector's energy stays above the level of a change
+ * of more than 10 in one direction for a few samples, see motion.h
  * This is due the small vibrations detected by the accelerometer when stationary
  */
 int checkForMovement(){
-	if(abs(x-prevX) > 10 || abs(y-prevY) > 10 || abs(z-prevZ) > 10){
-		storePreviousAccelerometerValues();
-		return 1;
-	}
+	int moved = movementSeen;
+
+	if(motionSource == MOTION_SENSOR)
+		moved = acc_getMotion() != 0;
+
+	movementSeen = 0;
 	storePreviousAccelerometerValues();
-	return 0;
+	return moved;
 }
 
 /**
  * Depending on the Sensors determine the warning to issue to the system
  */
 void determineWarningToIssue(){
-	// Read accelerometer value and check for movement
-	readAccelerometer();
+	// Check for movement in the samples read so far
 	isThereMovement = checkForMovement();
 
 	if(warning == NONE){
 		// Check to see if there are any warnings
-		if(temperature/10.0 > TEMP_HIGH_WARNING && isThereMovement && lightLowWarning == 1)
+		if((int16_t) temperature > tempHighWarning && isThereMovement && lightLowWarning == 1)
 			warning = HIGH_TERMPATURE_AND_MOVEMENT_IN_LOW_LIGHT;
-		else if (temperature/10.0 > TEMP_HIGH_WARNING)
+		else if ((int16_t) temperature > tempHighWarning)
 			warning = HIGH_TEMPERATURE;
 		else if (lightLowWarning == 1 && isThereMovement)
 			warning = MOVEMENT_IN_LOW_LIGHT;
 	} else if (warning == MOVEMENT_IN_LOW_LIGHT){
 		// Check temperature
-		if (temperature/10.0 > TEMP_HIGH_WARNING)
+		if ((int16_t) temperature > tempHighWarning)
 			warning = HIGH_TERMPATURE_AND_MOVEMENT_IN_LOW_LIGHT;
 	} else if (warning == HIGH_TEMPERATURE){
 		// Check for light
@@ -570,22 +792,37 @@ void determineWarningToIssue(){
  */
 void enableInterruptsDependingOnWarning(){
 	if(warning == NONE){
+		swtimer_stop(&blinkTimer);
 		rgb_setLeds(0);
-		NVIC_DisableIRQ(TIMER2_IRQn);
-	} else {
-		NVIC_EnableIRQ(TIMER2_IRQn);
+	} else if(!swtimer_isActive(&blinkTimer)){
+		swtimer_start(&blinkTimer, BLINK_PERIOD, BLINK_PERIOD, runWarning);
 	}
 }
 
+/**
+ * Append a label and a value left justified in 5 characters to buf
+ * Same as "<label>%-5d", or "<label>%-5.1f" on value/10.0 when decimals is 1
+ * Returns the new length of the string in buf
+ */
+uint32_t appendField(char *buf, uint32_t len, const char *label, int32_t value, uint8_t decimals){
+	uint32_t start;
+
+	len += fmt_string(buf + len, label);
+	start = len;
+	len += fmt_fixed(buf + len, value, decimals);
+
+	return fmt_padRight(buf, len, start + 5);
+}
+
 /**
  * Create the STrings to Display on the OLED
  */
 void createStringsToDisplayOnOLED(){
-	sprintf(OLED_TEMPERATURE, "Temp: %-5.1f", temperature/10.0);
-	sprintf(OLED_LIGHT, "Light: %-5lu", light);
-	sprintf(OLED_X, "X: %-5d", x);
-	sprintf(OLED_Y, "y: %-5d", y);
-	sprintf(OLED_Z, "z: %-5d", z);
+	appendField(OLED_TEMPERATURE, 0, "Temp: ", (int16_t) temperature, 1);
+	appendField(OLED_LIGHT, 0, "Light: ", light, 0);
+	appendField(OLED_X, 0, "X: ", x, 0);
+	appendField(OLED_Y, 0, "y: ", y, 0);
+	appendField(OLED_Z, 0, "z: ", z, 0);
 }
 
 /**
@@ -600,34 +837,96 @@ void displayStringsOnOLED(){
 }
 
 /**
- * Function to initialize the temperature interrupt
+ * Display the sensor values on the OLED
  */
-void init_temp_interrupt() {
+void displayValuesOnOLED(){
+	createStringsToDisplayOnOLED();
+	displayStringsOnOLED();
+}
 
-	LPC_GPIOINT->IO0IntClr |= (1 << 2);
-	LPC_GPIOINT->IO0IntEnF |= (1 << 2);
+/**
+ * Init hook of the temperature sensor
+ * The period is measured in the background by the temperature driver
+ */
+int32_t initTempSensor(){
+	temp_init(getTicks);
+	temp_setAlarmLevel(tempHighWarning, TEMP_FAST_BAND);
+	temp_setProfile(TEMP_PROFILE_AUTO);
+	return 0;
+}
 
-	NVIC_ClearPendingIRQ(EINT3_IRQn);
-	NVIC_EnableIRQ(EINT3_IRQn);
+/**
+ * Read hook of the temperature sensor, the latest reading if there is one
+ */
+uint8_t readTempSensor(int32_t *raw){
+	return temp_poll(&raw[0]) ? 1 : 0;
 }
 
 /**
- * Display the sensor values on the OLED
+ * Convert hook of the temperature sensor, apply the calibrated offset
  */
-void displayValuesOnOLED(){
-	createStringsToDisplayOnOLED();
-	displayStringsOnOLED();
+void convertTemp(int32_t *value, uint8_t count){
+	value[0] += calibration.tempOffset;
 }
 
 /**
- * Check to see if it has reached 5, 10, 15 seconds
- * segCount is 1 value higher as it is incremented by run7seg
+ * Take a sample of the temperature
  */
-int isFiveOrTenOrFifteenSeconds(){
-	if(segCount == 6 || segCount == 11 || segCount == 0)
-		return 1;
+void takeTemperature(const sensor_sample_t *sample){
+	temperature = sample->value[0];
+}
 
-	return 0;
+/**
+ * Read hook of the light sensor
+ */
+uint8_t readLightSensor(int32_t *raw){
+	raw[0] = light_read();
+	return 1;
+}
+
+/**
+ * Convert hook of the light sensor, apply the calibrated gain
+ */
+void convertLight(int32_t *value, uint8_t count){
+	value[0] = ((uint32_t) value[0] * calibration.lightGain) >> 12;
+}
+
+/**
+ * Take a sample of the light, the sensors are shown at the light's rate
+ */
+void takeLight(const sensor_sample_t *sample){
+	light = sample->value[0];
+	displayDue = 1;
+}
+
+/**
+ * The sensors, read by sensor_poll
+ * They only run in MONITOR mode, see enableAllOperations
+ * The accelerometer is not read here while the sensor detects movement
+ */
+const sensor_desc_t tempSensorDesc = {
+	"temp", initTempSensor, temp_start, temp_stop, readTempSensor, convertTemp,
+	TEMP_READ_PERIOD, 1, TEMP_READ_PERIOD
+};
+const sensor_desc_t lightSensorDesc = {
+	"light", NULL, NULL, NULL, readLightSensor, convertLight,
+	SAMPLE_INTERVAL * 1000, 1, 100
+};
+const sensor_desc_t accSensorDesc = {
+	"acc", NULL, startAccSensor, acc_stopSampling, readAccSensor, convertAcc,
+	ACC_READ_PERIOD, 1, ACC_READ_PERIOD
+};
+
+/**
+ * Register the sensors, they are started with the MONITOR mode
+ */
+void init_sensors(){
+	tempSensor = sensor_register(&tempSensorDesc);
+	lightSensor = sensor_register(&lightSensorDesc);
+	accSensor = sensor_register(&accSensorDesc);
+	sensor_subscribe(tempSensor, takeTemperature);
+	sensor_subscribe(lightSensor, takeLight);
+	sensor_subscribe(accSensor, takeAcc);
 }
 
 /**
@@ -641,141 +940,762 @@ int isFifteenSeconds(){
 	return 0;
 }
 
+/**
+ * Check if the current warning includes high temperature
+ */
+int isHighTemperatureWarning(){
+	return warning == HIGH_TERMPATURE_AND_MOVEMENT_IN_LOW_LIGHT || warning == HIGH_TEMPERATURE;
+}
+
+/**
+ * Check if the current warning includes movement in low light
+ */
+int isMovementWarning(){
+	return warning == HIGH_TERMPATURE_AND_MOVEMENT_IN_LOW_LIGHT || warning == MOVEMENT_IN_LOW_LIGHT;
+}
+
+/**
+ * Collect the sensor values as a telemetry sample
+ * The warnings are carried as bits instead of the text messages
+ */
+void getTelemetrySample(telemetry_sample_t *sample){
+	sample->seq = message;
+	sample->timestamp = getTicks();
+	sample->temperature = temperature;
+	sample->light = light;
+	sample->x = x;
+	sample->y = y;
+	sample->z = z;
+	sample->warnings = 0;
+	if(isHighTemperatureWarning())
+		sample->warnings |= TELEMETRY_WARN_HIGH_TEMP;
+	if(isMovementWarning())
+		sample->warnings |= TELEMETRY_WARN_MOVEMENT;
+}
+
+/**
+ * Send the sensor values as one binary telemetry frame, fixed or delta
+ */
+void sendTelemetryFrame(const telemetry_sample_t *sample){
+	uint32_t len;
+
+	if(telemetryFormat == FORMAT_DELTA)
+		len = telemetry_deltaFrame(&deltaEncoder, sample, telemetryFrame);
+	else
+		len = telemetry_frame(sample, telemetryFrame);
+
+	// A dropped record breaks the deltas after it, restart from a keyframe
+	if(uart_write(telemetryFrame, len) == 0 && telemetryFormat == FORMAT_DELTA)
+		telemetry_deltaKey(&deltaEncoder);
+}
+
+/**
+ * Keep a sample in the history as a fixed binary frame
+ * The oldest frames are dropped to make room, up to their 0x00 delimiter
+ * Nothing is kept while the history is being dumped
+ */
+void recordHistory(const telemetry_sample_t *sample){
+	uint8_t frame[TELEMETRY_FRAME_MAX];
+	uint32_t len;
+	uint32_t i;
+
+	if(dumping)
+		return;
+
+	len = telemetry_frame(sample, frame);
+	while(historyLen + len > HISTORY_SIZE){
+		while(history[(historyHead - historyLen) & (HISTORY_SIZE - 1)] != 0)
+			historyLen--;
+		historyLen--;
+	}
+
+	for(i = 0; i < len; i++){
+		history[historyHead] = frame[i];
+		historyHead = (historyHead + 1) & (HISTORY_SIZE - 1);
+	}
+	historyLen += len;
+}
+
 /**
  * Display the sensor values on the UART
  */
 void displayResultsOnUART(){
-	if(warning == HIGH_TERMPATURE_AND_MOVEMENT_IN_LOW_LIGHT || warning == HIGH_TEMPERATURE)
-		UART_Send(LPC_UART3, (uint8_t *) displayHighTempWarning, strlen(displayHighTempWarning), BLOCKING);
-
-	if(warning == HIGH_TERMPATURE_AND_MOVEMENT_IN_LOW_LIGHT || warning == MOVEMENT_IN_LOW_LIGHT)
-		UART_Send(LPC_UART3, (uint8_t *) displayMovementInLowLight, strlen(displayMovementInLowLight), BLOCKING);
+	char *line = (char *) displayValuesToUART;
+	telemetry_sample_t sample;
+	uint32_t len;
+
+	readAccelerometerOnDemand();
+	getTelemetrySample(&sample);
+	recordHistory(&sample);
+
+	if(telemetryFormat != FORMAT_TEXT){
+		sendTelemetryFrame(&sample);
+		message++;
+		return;
+	}
 
-	sprintf(displayValuesToUART, "%03d_-_T%-5.1f_L%-5lu_AX%-5d_AY%-5d_AZ%-5d\r\n", message, temperature/10.0, light, x, y, z);
-	UART_Send(LPC_UART3, (uint8_t *) displayValuesToUART, strlen(displayValuesToUART), BLOCKING);
+	if(isHighTemperatureWarning())
+		uart_write((uint8_t *) displayHighTempWarning, strlen(displayHighTempWarning));
+
+	if(isMovementWarning())
+		uart_write((uint8_t *) displayMovementInLowLight, strlen(displayMovementInLowLight));
+
+	// Same as "%03d_-_T%-5.1f_L%-5lu_AX%-5d_AY%-5d_AZ%-5d\r\n"
+	len = fmt_uint(line, message, 3);
+	len = appendField(line, len, "_-_T", (int16_t) temperature, 1);
+	len = appendField(line, len, "_L", light, 0);
+	len = appendField(line, len, "_AX", x, 0);
+	len = appendField(line, len, "_AY", y, 0);
+	len = appendField(line, len, "_AZ", z, 0);
+	len += fmt_string(line + len, "\r\n");
+	uart_write((uint8_t *) line, len);
 	message++;
 }
 
+/**
+ * Publish the sensor values to the I2C slave register map and the Modbus registers
+ * The warning bits are the same for both
+ */
+void publishRegisterMap(){
+	uint8_t warnings = 0;
+
+	if(isHighTemperatureWarning())
+		warnings |= REGMAP_WARN_HIGH_TEMP;
+
+	if(isMovementWarning())
+		warnings |= REGMAP_WARN_MOVEMENT;
+
+	regmap_update(temperature, light, x, y, z, warnings);
+	modbus_update(temperature, light, x, y, z, warnings);
+}
+
+/**
+ * Change the light threshold
+ * The limits of the Light Sensor are re-applied for the current light level
+ */
+void setLightThreshold(uint32_t lux){
+	NVIC_DisableIRQ(EINT3_IRQn);
+	interruptDarkLowerLimit = lux;
+	interruptLightUpperLimit = lux - 1;
+	flipLightLimits();
+	if(mode == MODE_MONITOR)
+		NVIC_EnableIRQ(EINT3_IRQn);
+}
+
+/**
+ * Select the temperature conversion profile by name
+ * Returns 0 on success, -1 for an unknown name
+ */
+int setTempProfile(const char *name){
+	int i;
+
+	if(strcmp(name, "auto") == 0){
+		temp_setProfile(TEMP_PROFILE_AUTO);
+		tempProfileAuto = 1;
+		return 0;
+	}
+
+	for(i = 0; i < TEMP_NUM_PROFILES; i++){
+		if(strcmp(name, tempProfileNames[i]) == 0){
+			temp_setProfile((temp_profile_t) i);
+			tempProfileAuto = 0;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Select where movement is detected
+ * The sensor's detection is armed with the rest position from start up
+ */
+void setMotionSource(motion_source source){
+	if(source == motionSource)
+		return;
+
+	stopMotion();
+	motionSource = source;
+	startMotion();
+	movementSeen = 0;
+}
+
+/**
+ * Shell command to print the settings
+ */
+void cmdGet(int argc, char *argv[]){
+	shell_printValue("temp", tempHighWarning, 1);
+	shell_printValue("light", interruptDarkLowerLimit, 0);
+	shell_printValue("rate", sampleInterval, 0);
+	if(telemetryFormat == FORMAT_DELTA)
+		shell_print("format delta\r\n");
+	else if(telemetryFormat == FORMAT_BINARY)
+		shell_print("format bin\r\n");
+	else
+		shell_print("format text\r\n");
+	shell_print(mode == MODE_MONITOR ? "mode monitor\r\n" : "mode stable\r\n");
+	shell_print(tempProfileAuto ? "tprofile auto " : "tprofile ");
+	shell_print(tempProfileNames[temp_getProfile()]);
+	shell_print("\r\n");
+	shell_print(motionSource == MOTION_SENSOR ? "motion sensor\r\n" : "motion samples\r\n");
+	shell_printValue("modbusaddr", calibration.modbusAddr, 0);
+}
+
+/**
+ * Shell command to change a setting
+ */
+void cmdSet(int argc, char *argv[]){
+	int32_t value;
+
+	if(argc != 3){
+		shell_print("usage: set temp|light|rate|format|tprofile|motion|modbusaddr <value>\r\n");
+		return;
+	}
+
+	if(strcmp(argv[1], "format") == 0){
+		if(strcmp(argv[2], "bin") == 0)
+			telemetryFormat = FORMAT_BINARY;
+		else if(strcmp(argv[2], "text") == 0)
+			telemetryFormat = FORMAT_TEXT;
+		else if(strcmp(argv[2], "delta") == 0){
+			// Start the stream with a keyframe
+			telemetry_deltaInit(&deltaEncoder, DELTA_KEY_INTERVAL);
+			telemetryFormat = FORMAT_DELTA;
+		} else {
+			shell_print("error: format is text, bin or delta\r\n");
+			return;
+		}
+	} else if(strcmp(argv[1], "temp") == 0){
+		// In Celcius, one decimal
+		if(shell_parseValue(argv[2], 1, &value) != 0 || value < -400 || value > 1250){
+			shell_print("error: temp is -40.0 to 125.0\r\n");
+			return;
+		}
+		tempHighWarning = value;
+		temp_setAlarmLevel(tempHighWarning, TEMP_FAST_BAND);
+	} else if(strcmp(argv[1], "tprofile") == 0){
+		if(setTempProfile(argv[2]) != 0){
+			shell_print("error: tprofile is auto, fast, normal or precise\r\n");
+			return;
+		}
+	} else if(strcmp(argv[1], "motion") == 0){
+		if(strcmp(argv[2], "sensor") == 0)
+			setMotionSource(MOTION_SENSOR);
+		else if(strcmp(argv[2], "samples") == 0)
+			setMotionSource(MOTION_SAMPLES);
+		else {
+			shell_print("error: motion is samples or sensor\r\n");
+			return;
+		}
+	} else if(strcmp(argv[1], "light") == 0){
+		if(shell_parseValue(argv[2], 0, &value) != 0 || value < 1 || value > interruptDarkUpperLimit){
+			shell_print("error: light is 1 to 3891\r\n");
+			return;
+		}
+		setLightThreshold(value);
+	} else if(strcmp(argv[1], "modbusaddr") == 0){
+		// Kept in the calibration record, so it is the same after a reset
+		if(shell_parseValue(argv[2], 0, &value) != 0 || value < 1 || value > MODBUS_ADDR_MAX){
+			shell_print("error: modbusaddr is 1 to 247\r\n");
+			return;
+		}
+		calibration.modbusAddr = value;
+		modbus_setAddress(calibration.modbusAddr);
+		if(calib_save(&calibration) != 0){
+			shell_print("error: EEPROM write failed\r\n");
+			return;
+		}
+	} else if(strcmp(argv[1], "rate") == 0){
+		if(shell_parseValue(argv[2], 0, &value) != 0 || value < 1 || value > 15){
+			shell_print("error: rate is 1 to 15\r\n");
+			return;
+		}
+		sampleInterval = value;
+		sensor_setPeriod(lightSensor, sampleInterval * 1000);
+	} else {
+		shell_print("error: unknown setting\r\n");
+		return;
+	}
+
+	shell_print("ok\r\n");
+}
+
+/**
+ * Shell command to show or change the mode
+ */
+void cmdMode(int argc, char *argv[]){
+	system_mode newMode;
+
+	if(argc == 1){
+		shell_print(mode == MODE_MONITOR ? "mode monitor\r\n" : "mode stable\r\n");
+		return;
+	}
+
+	if(strcmp(argv[1], "monitor") == 0)
+		newMode = MODE_MONITOR;
+	else if(strcmp(argv[1], "stable") == 0)
+		newMode = MODE_STABLE;
+	else {
+		shell_print("error: mode is stable or monitor\r\n");
+		return;
+	}
+
+	if(newMode != mode)
+		changeMode();
+	shell_print("ok\r\n");
+}
+
+/**
+ * Shell command to print the latest accelerometer values and the peak in g
+ * They are relative to the rest position, 1/64 g per count
+ */
+void cmdAcc(int argc, char *argv[]){
+	shell_printValue("x", ACC_10BIT_TO_MG(x), 3);
+	shell_printValue("y", ACC_10BIT_TO_MG(y), 3);
+	shell_printValue("z", ACC_10BIT_TO_MG(z), 3);
+	// Not relative to the rest position, up to 8 g
+	shell_printValue("peak", shockPeakMg, 3);
+	shockPeakMg = 0;
+}
+
+/**
+ * Shell command to show the counters
+ */
+void cmdStats(int argc, char *argv[]){
+	char label[16];
+	uint32_t i;
+
+	shell_printValue("uptime", getTicks(), 3);
+	shell_printValue("samples", message, 0);
+	shell_printValue("txdrop", uart_getDropCount(), 0);
+	shell_printValue("rxoverflow", uart_getRxOverflowCount(), 0);
+	shell_printValue("modbuserrors", modbus_getErrorCount(), 0);
+	shell_printValue("accoverflow", acc_getOverflowCount(), 0);
+	shell_printValue("shocks", shockCount, 0);
+	shell_printValue("wakes", event_getWakeCount(), 0);
+	for(i = 0; i < sensor_count(); i++){
+		// Reads started later than the sensor's latency budget
+		strcpy(label, sensor_getName(i));
+		strcat(label, "late");
+		shell_printValue(label, sensor_getLateCount(i), 0);
+	}
+}
+
+/**
+ * Shell command to change the baud rate of the terminal
+ * The reply is sent at the old rate, everything after at the new one
+ */
+void cmdBaud(int argc, char *argv[]){
+	int32_t value;
+
+	if(argc != 2 || shell_parseValue(argv[1], 0, &value) != 0 || value <= 0){
+		shell_print("usage: baud <rate>\r\n");
+		return;
+	}
+
+	if(dumping){
+		shell_print("error: dump running\r\n");
+		return;
+	}
+
+	shell_print("ok\r\n");
+	if(uart_setBaudrate(value) != SUCCESS)
+		shell_print("error: rate not possible, unchanged\r\n");
+}
+
+/**
+ * Shell command to print the averaged analog inputs
+ */
+void cmdAdc(int argc, char *argv[]){
+	char label[] = "ad0";
+	uint32_t value;
+	uint8_t i;
+
+	for(i = 0; i < ADCDMA_NUM_INPUTS; i++){
+		if(!(ADC_INPUTS & (1 << i)))
+			continue;
+		label[2] = '0' + i;
+		if(adcdma_getValue(i, &value) == 0)
+			shell_printValue(label, value, 0);
+		else {
+			shell_print(label);
+			shell_print(" -\r\n");
+		}
+	}
+	shell_printValue("adcoverrun", adcdma_getOverrunCount(), 0);
+}
+
+/**
+ * Shell command to show or change the calibration record
+ * calib acc must be run with the board at rest
+ */
+void cmdCalib(int argc, char *argv[]){
+	int32_t value;
+
+	if(argc == 1){
+		// Rest position in counts, 1/16 count resolution
+		shell_printValue("accx", (calibration.accX * 100) / 16, 2);
+		shell_printValue("accy", (calibration.accY * 100) / 16, 2);
+		shell_printValue("accz", (calibration.accZ * 100) / 16, 2);
+		shell_printValue("accsamples", calibration.accSamples, 0);
+		shell_printValue("light", (calibration.lightGain * 1000) >> 12, 3);
+		shell_printValue("temp", calibration.tempOffset, 1);
+		return;
+	}
+
+	if(strcmp(argv[1], "acc") == 0 && argc == 2){
+		stopMotion();
+		value = calibrateAccelerometer();
+		setAccelerometerAtZeroG();
+		startMotion();
+
+		if(value != 0){
+			shell_print("error: accelerometer not read\r\n");
+			return;
+		}
+	} else if(strcmp(argv[1], "light") == 0 && argc == 3){
+		// Gain with three decimals
+		if(shell_parseValue(argv[2], 3, &value) != 0 || value < 250 || value > 4000){
+			shell_print("error: light gain is 0.250 to 4.000\r\n");
+			return;
+		}
+		calibration.lightGain = (value * CALIB_GAIN_ONE + 500) / 1000;
+		setLightThreshold(interruptDarkLowerLimit);
+	} else if(strcmp(argv[1], "temp") == 0 && argc == 3){
+		// In Celcius, one decimal
+		if(shell_parseValue(argv[2], 1, &value) != 0 || value < -100 || value > 100){
+			shell_print("error: temp offset is -10.0 to 10.0\r\n");
+			return;
+		}
+		calibration.tempOffset = value;
+	} else {
+		shell_print("usage: calib [acc | light <gain> | temp <offset>]\r\n");
+		return;
+	}
+
+	if(calib_save(&calibration) != 0){
+		shell_print("error: EEPROM write failed\r\n");
+		return;
+	}
+	shell_print("ok\r\n");
+}
+
+/**
+ * GPDMA call-back, the whole history has been written to the UART
+ */
+void dumpDone(uint8_t port, int32_t status){
+	event_post(EV_DUMP);
+}
+
+/**
+ * Shell command to send the sample history, or to clear it
+ * The history goes out by DMA as fixed binary frames, oldest first, for
+ * tools/telemetry_decode. Output queued meanwhile follows it.
+ */
+void cmdDump(int argc, char *argv[]){
+	uint32_t start;
+
+	if(argc == 2 && strcmp(argv[1], "clear") == 0){
+		if(dumping){
+			shell_print("error: dump running\r\n");
+			return;
+		}
+		historyLen = 0;
+		shell_print("ok\r\n");
+		return;
+	}
+
+	if(argc != 1){
+		shell_print("usage: dump [clear]\r\n");
+		return;
+	}
+
+	if(dumping){
+		shell_print("error: dump running\r\n");
+		return;
+	}
+
+	if(historyLen == 0){
+		shell_print("error: history empty\r\n");
+		return;
+	}
+
+	// The history wraps at most once, two buffers in the chain
+	start = (historyHead - historyLen) & (HISTORY_SIZE - 1);
+	dumpChain[0].data = &history[start];
+	dumpChain[0].next = NULL;
+	if(start + historyLen > HISTORY_SIZE){
+		dumpChain[0].len = HISTORY_SIZE - start;
+		dumpChain[0].next = &dumpChain[1];
+		dumpChain[1].data = history;
+		dumpChain[1].len = historyLen - dumpChain[0].len;
+		dumpChain[1].next = NULL;
+	} else {
+		dumpChain[0].len = historyLen;
+	}
+
+	dumping = 1;
+	uart_beginTxDma();
+	if(uartdma_sendChain(DUMP_UART, dumpChain, dumpDone) != 0){
+		uart_endTxDma();
+		dumping = 0;
+		shell_print("error: DMA busy\r\n");
+	}
+}
+
+/**
+ * Commands of the UART shell
+ */
+const shell_cmd_t shellCommands[] = {
+	{"get", "show thresholds, sample rate, format, mode and Modbus address", cmdGet},
+	{"set", "set temp <C> | light <lux> | rate <s> | format text|bin|delta | tprofile <p> | motion samples|sensor | modbusaddr <1-247>", cmdSet},
+	{"mode", "mode [stable|monitor]", cmdMode},
+	{"stats", "show uptime, UART and Modbus counters", cmdStats},
+	{"baud", "baud <rate>, e.g. 115200, 460800, 921600, 1000000", cmdBaud},
+	{"adc", "show the averaged analog inputs", cmdAdc},
+	{"acc", "show the accelerometer in g, relative to rest, and the peak since the last acc", cmdAcc},
+	{"calib", "calib [acc | light <gain> | temp <offset>], saved to the EEPROM", cmdCalib},
+	{"dump", "dump [clear], send the sample history as binary frames", cmdDump}
+};
+
 /**
  * Every time the GPIO interrupts are fired (regardless of which pin), this subroutine is called.
  * ISR Implementation
  */
 void EINT3_IRQHandler (void){
 	// Change the flag when interrupt occurs
+	// The light task flips the limits, the main loop may be using I2C2
 	if ((LPC_GPIOINT->IO2IntStatF >> 5) & 0x1) {
 		LPC_GPIOINT->IO2IntClr = 1 << 5;
 		lightLowWarning = !lightLowWarning;
+		event_post(EV_LIGHT);
+	}
+
+	// Temperature sensor edges, only used when it is not on the timer counter
+	temp_edge();
+
+	// Accelerometer data ready, or movement detected by the sensor
+	acc_drdy();
+	acc_motionEvent();
+	if(acc_motionPending())
+		event_post(EV_MOTION);
+}
+
+/**
+ * Task to change the mode when SW4 is pressed
+ * The tick posts the button while it is held, the wait de-bounces it
+ */
+int8_t runButtonTask(task_t *t){
+	TASK_BEGIN(t);
+	while(1){
+		TASK_WAIT_EVENT(t, EV_BUTTON);
+		changeMode();
+		TASK_SLEEP(t, 500);
+	}
+	TASK_END(t);
+}
+
+/**
+ * Task to run any command received on the UART
+ */
+int8_t runShellTask(task_t *t){
+	TASK_BEGIN(t);
+	while(1){
+		TASK_WAIT_EVENT(t, EV_UART_RX);
+		shell_poll();
+	}
+	TASK_END(t);
+}
+
+/**
+ * Task to turn the operations on and off with the mode
+ * Added before the tasks that only work in MONITOR mode, so they never
+ * see the mode before the operations follow it
+ */
+int8_t runModeTask(task_t *t){
+	TASK_BEGIN(t);
+	while(1){
+		turnOffAllOperations();
+		TASK_WAIT_UNTIL(t, mode == MODE_MONITOR);
+		enableAllOperations();
+		TASK_WAIT_UNTIL(t, mode == MODE_STABLE);
+	}
+	TASK_END(t);
+}
+
+/**
+ * Task to read the sensors that are due
+ */
+int8_t runSensorTask(task_t *t){
+	TASK_BEGIN(t);
+	while(1){
+		TASK_WAIT_EVENT(t, EV_TICK | EV_TEMP);
+		sensor_poll(task_now());
+	}
+	TASK_END(t);
+}
+
+/**
+ * Task to flip the light limits and re-arm the sensor after its interrupt
+ * The sensor holds its interrupt until cleared, so there is no other one
+ * in between
+ */
+int8_t runLightTask(task_t *t){
+	TASK_BEGIN(t);
+	while(1){
+		TASK_WAIT_EVENT(t, EV_LIGHT);
 		flipLightLimits();
-	}else if ((LPC_GPIOINT->IO0IntStatF >> 2) & 0x1){
-		if (temp1 == 0 && temp2 == 0) {
-			temp1 = getTicks();
-		}
-		else if (temp1 != 0 && temp2 == 0) {
-			tempState++;
-			if (tempState == 170) {
-				temp2 = getTicks();
-				if (temp2 > temp1) {
-					temp2 = temp2 - temp1;
-				}
-				else {
-					temp2 = (0xFFFFFFFF - temp1 + 1) + temp2;
-				}
-				temperature = ((2*1000*temp2) / (340*1) - 2731);
-				temp2 = 0;
-				temp1 = 0;
-				tempState = 0;
-			}
+	}
+	TASK_END(t);
+}
+
+/**
+ * Task to determine the warning every second
+ * Does not wait for the next second when it got dark or the sensor saw movement
+ */
+int8_t runWarningTask(task_t *t){
+	TASK_BEGIN(t);
+	while(1){
+		TASK_WAIT_EVENT(t, EV_SECOND | EV_LIGHT | EV_MOTION);
+		if(mode != MODE_MONITOR)
+			continue;
+		if(t->events == EV_MOTION && motionSource != MOTION_SENSOR)
+			continue;
+		determineWarningToIssue();
+		enableInterruptsDependingOnWarning();
+	}
+	TASK_END(t);
+}
+
+/**
+ * Task to send the values on the UART every 15 seconds and publish them every second
+ */
+int8_t runTelemetryTask(task_t *t){
+	TASK_BEGIN(t);
+	while(1){
+		TASK_WAIT_EVENT(t, EV_SECOND);
+		if(mode != MODE_MONITOR)
+			continue;
+		if(isFifteenSeconds())
+			displayResultsOnUART();
+		publishRegisterMap();
+	}
+	TASK_END(t);
+}
+
+/**
+ * Task to give the terminal back to the UART ring when a dump is done
+ */
+int8_t runDumpTask(task_t *t){
+	TASK_BEGIN(t);
+	while(1){
+		TASK_WAIT_EVENT(t, EV_DUMP);
+		uart_endTxDma();
+		dumping = 0;
+	}
+	TASK_END(t);
+}
+
+/**
+ * Task to show the sensors on the OLED when a light sample came in
+ */
+int8_t runDisplayTask(task_t *t){
+	TASK_BEGIN(t);
+	while(1){
+		TASK_WAIT_UNTIL(t, displayDue);
+		displayDue = 0;
+		if(mode == MODE_MONITOR){
+			readAccelerometerOnDemand();
+			displayValuesOnOLED();
 		}
-		LPC_GPIOINT->IO0IntClr = (1 << 2);
 	}
+	TASK_END(t);
 }
 
 /**
- * Function to handle the Timer1 interrupt
- * Credits given to: https://exploreembedded.com/wiki/LPC1768:_Timers
+ * Add the tasks, in the order they run after each event
  */
-void TIMER1_IRQHandler(void){
-    unsigned int isrMask;
-    isrMask = LPC_TIM1->IR;
-    LPC_TIM1->IR = isrMask;		// Clear the Interrupt Bit
-	change7Seg();				// Change the 7 Segment
-	oneSecondHasReached = 1;	// Change Flag
+void init_tasks(){
+	task_add(&buttonTask, runButtonTask);
+	task_add(&shellTask, runShellTask);
+	task_add(&modeTask, runModeTask);
+	task_add(&sensorTask, runSensorTask);
+	task_add(&lightTask, runLightTask);
+	task_add(&warningTask, runWarningTask);
+	task_add(&telemetryTask, runTelemetryTask);
+	task_add(&displayTask, runDisplayTask);
+	task_add(&dumpTask, runDumpTask);
 }
 
 /**
- * Function to handle the Timer2 interrupt
- * Credits given to: https://exploreembedded.com/wiki/LPC1768:_Timers
+ * Have the tick wake the main loop when the next sensor read or sleeping
+ * task is due, with neither it only wakes for the other events
  */
-void TIMER2_IRQHandler(void){
-    unsigned int isrMask;
-    isrMask = LPC_TIM2->IR;
-    LPC_TIM2->IR = isrMask;		// Clear the Interrupt Bit
-    runWarning();				// Run the necessary warnings at the interrupt
+void scheduleTick(){
+	uint32_t due = 0;
+	uint32_t wake = 0;
+	int found;
+
+	found = sensor_nextDue(getTicks(), &due) == 0;
+	if(task_nextWake(&wake) == 0){
+		if(!found || (int32_t)(wake - due) < 0)
+			due = wake;
+		found = 1;
+	}
+
+	tickArmed = 0;
+	tickAt = due;
+	tickArmed = found;
 }
 
 /**
  * Main Function
  */
 int main (void) {
+	uint32_t events;
+
 	// Setup SysTick Timer to interrupt at 1msec intervals
 	if (SysTick_Config(SystemCoreClock / 1000))
 	    while (1);  // Capture error
 
 	// Initialize the device
     init_i2c();
+    loadCalibration();
     init_ssp();
     init_GPIO();
     init_uart();
-    init_timer1Interrupt();
-    init_timer2Interrupt();
+    swtimer_init();
+    // The light sensor resets its range when enabled, enable it first
+    light_enable();
     init_lightInterrupt();
     pca9532_init();
     joystick_init();
     oled_init();
     rgb_init();
     acc_init();
-    light_enable();
     led7seg_init();
-    init_temp_interrupt();
-
-    // Initialize Accelerometer to 0
+    init_sensors();
+    regmap_init(REGMAP_I2C_ADDR);
+    modbus_init(calibration.modbusAddr, MODBUS_BAUDRATE);
+    init_adc();
+    shell_init(shellCommands, sizeof(shellCommands) / sizeof(shellCommands[0]));
+
+    // Initialize Accelerometer to 0, it is sampled from the MONITOR mode on
+    // Without a record the board must be at rest, as it always had to be
+    if(calibration.accSamples == 0 && calibrateAccelerometer() == 0)
+    	calib_save(&calibration);
     setAccelerometerAtZeroG();
+    init_tasks();
 
-    // Set start time for the De-bouncing of SW4
-    sw4PressTicks = getTicks();
+    // The interrupts wake the main loop with events from here on
+    temp_setReadyHandler(postTempReady);
+    uart_setRxHandler(postUartRx);
 
     while (1){
-    	// Switch to determine the changing of mode
-    	if(isSwitch4Pressed())
-    		changeMode();
-
-    	// Configure the operations to run depending on the mode
-    	switch(mode){
-    		case MODE_STABLE:
-    			if(isFirstTimeEnterStable)
-    				turnOffAllOperations();
-    		break;
-
-    		case MODE_MONITOR:
-    			if(isFirstTimeEnterMonitor)
-    				enableAllOperations();
-
-    	        if(oneSecondHasReached){
-    	        	determineWarningToIssue();
-    	        	enableInterruptsDependingOnWarning();
-    	        	if(isFiveOrTenOrFifteenSeconds()){
-    	        		light = light_read();
-    	        		readAccelerometer();
-						displayValuesOnOLED();
-    	        	}
-
-    	        	if(isFifteenSeconds())
-    	        		displayResultsOnUART();
-
-    	        	oneSecondHasReached = 0; // Reset the one second flag
-    	        }
-    		break;
-    	}
+    	// Sleep until an interrupt posts an event, then run the tasks it lets go on
+    	events = event_wait();
+    	task_run(events, getTicks());
+    	scheduleTick();
     }
 }
 
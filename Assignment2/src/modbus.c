@@ -0,0 +1,460 @@
+/*****************************************************************************
+ *   modbus.c:  Modbus RTU slave on UART1 (RS-485) serving the latest
+ *              sensor values
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * UART1 uses P0.15 TXD1 and P0.16 RXD1. RTS1 on P0.22 enables the RS-485
+ * driver while a reply is sent (auto direction control).
+ *
+ * Every received byte restarts TIMER0. When the line has been silent for
+ * 3.5 character times TIMER0_IRQHandler takes the bytes as one frame,
+ * checks it and starts the reply, which UART1_IRQHandler feeds into the
+ * TX FIFO. Both interrupts run at the same priority, so they never
+ * preempt each other. The main loop only publishes a new snapshot with
+ * modbus_update().
+ *
+ * Only Read Holding Registers (0x03) and Read Input Registers (0x04) are
+ * supported, other functions get an illegal function exception.
+ * Broadcasts (address 0) are ignored as they are write only.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "lpc17xx_pinsel.h"
+#include "lpc17xx_uart.h"
+#include "modbus.h"
+
+/******************************************************************************
+ * Defines and typedefs
+ *****************************************************************************/
+
+#define UARTDEV LPC_UART1
+
+#define FC_READ_HOLDING   0x03
+#define FC_READ_INPUT     0x04
+
+#define EX_ILLEGAL_FUNCTION  0x01
+#define EX_ILLEGAL_ADDRESS   0x02
+#define EX_ILLEGAL_VALUE     0x03
+
+/* Most registers in one read, limited by the PDU size */
+#define MAX_READ_REGS 125
+
+typedef enum
+{
+    STATE_IDLE,
+    STATE_RECEIVE,  /* bytes of a request are coming in */
+    STATE_REPLY     /* sending a reply, then 3.5 characters of silence */
+} modbus_state_t;
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+/* CRC16 (poly 0xA001 reflected, init 0xFFFF), one entry per byte */
+static const uint16_t crcTable[256] = {
+    0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+    0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+    0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+    0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+    0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+    0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+    0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+    0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+    0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+    0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+    0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+    0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+    0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+    0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+    0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+    0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+    0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+    0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+    0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+    0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+    0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+    0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+    0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+    0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+    0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+    0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+    0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+    0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+    0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+    0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+    0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+    0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
+
+static uint16_t regs[2][MODBUS_NUM_REGS];
+
+/* Image requests are served from, modbus_update() fills the other one */
+static volatile uint8_t front = 0;
+
+static uint8_t slave = MODBUS_SLAVE_ADDR;
+
+static volatile modbus_state_t state = STATE_IDLE;
+
+static uint8_t rxBuf[MODBUS_ADU_MAX];
+static uint32_t rxLen = 0;
+
+/* Set on a UART error or overlong frame, the frame is dropped */
+static uint8_t rxBad = 0;
+
+static uint8_t txBuf[MODBUS_ADU_MAX];
+static uint32_t txLen = 0;
+static uint32_t txPos = 0;
+
+static uint32_t samples = 0;
+static volatile uint32_t errorCount = 0;
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+/* Start the 3.5 character silence timer from 0 */
+static void restartTimer(void)
+{
+    LPC_TIM0->TCR = (1 << 1);   // Reset
+    LPC_TIM0->TCR = (1 << 0);   // Count, stops again on MR0
+}
+
+/* Move up to one FIFO worth of the reply to the UART */
+static void fillFifo(void)
+{
+    uint32_t n = 16;
+
+    while (n && txPos < txLen) {
+        UARTDEV->THR = txBuf[txPos++];
+        n--;
+    }
+
+    /* all sent, keep the line quiet before listening again */
+    if (n == 16)
+        restartTimer();
+}
+
+static void receive(void)
+{
+    uint8_t lsr;
+    uint8_t c;
+
+    while ((lsr = UARTDEV->LSR) & UART_LSR_RDR) {
+        c = UARTDEV->RBR;
+
+        /* own reply, echoed by the transceiver */
+        if (state == STATE_REPLY)
+            continue;
+
+        if (state == STATE_IDLE) {
+            rxLen = 0;
+            rxBad = 0;
+            state = STATE_RECEIVE;
+        }
+
+        if (lsr & (UART_LSR_OE | UART_LSR_PE | UART_LSR_FE | UART_LSR_BI))
+            rxBad = 1;
+
+        if (rxLen < MODBUS_ADU_MAX)
+            rxBuf[rxLen++] = c;
+        else
+            rxBad = 1;
+    }
+
+    if (state == STATE_RECEIVE)
+        restartTimer();
+}
+
+static uint32_t exception(uint8_t code)
+{
+    txBuf[1] |= 0x80;
+    txBuf[2] = code;
+
+    return 3;
+}
+
+/* Build the reply of a request, returns its length without the CRC */
+static uint32_t handleRequest(void)
+{
+    const uint16_t *img = regs[front];
+    uint32_t start;
+    uint32_t count;
+    uint32_t len;
+    uint32_t i;
+
+    txBuf[0] = slave;
+    txBuf[1] = rxBuf[1];
+
+    if (rxBuf[1] != FC_READ_HOLDING && rxBuf[1] != FC_READ_INPUT)
+        return exception(EX_ILLEGAL_FUNCTION);
+
+    if (rxLen != 8)
+        return exception(EX_ILLEGAL_VALUE);
+
+    start = (rxBuf[2] << 8) | rxBuf[3];
+    count = (rxBuf[4] << 8) | rxBuf[5];
+
+    if (count == 0 || count > MAX_READ_REGS)
+        return exception(EX_ILLEGAL_VALUE);
+
+    if (start + count > MODBUS_NUM_REGS)
+        return exception(EX_ILLEGAL_ADDRESS);
+
+    txBuf[2] = (uint8_t)(count * 2);
+    len = 3;
+    for (i = 0; i < count; i++) {
+        txBuf[len++] = (uint8_t)(img[start + i] >> 8);
+        txBuf[len++] = (uint8_t)img[start + i];
+    }
+
+    return len;
+}
+
+/* A complete frame has been received */
+static void handleFrame(void)
+{
+    uint32_t len;
+    uint16_t crc;
+
+    state = STATE_IDLE;
+
+    /* the CRC over a frame including its own CRC is 0 */
+    if (rxBad || rxLen < 4 || modbus_crc16(rxBuf, rxLen) != 0) {
+        errorCount++;
+        return;
+    }
+
+    if (rxBuf[0] != slave)
+        return;
+
+    len = handleRequest();
+    crc = modbus_crc16(txBuf, len);
+    txBuf[len++] = (uint8_t)crc;
+    txBuf[len++] = (uint8_t)(crc >> 8);
+
+    txLen = len;
+    txPos = 0;
+    state = STATE_REPLY;
+    fillFifo();
+}
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Configure UART1 for RS-485 and TIMER0 for the frame gaps, and start
+ *    answering requests
+ *
+ * Params:
+ *   [in] slaveAddr - Modbus slave address, 1 to MODBUS_ADDR_MAX
+ *   [in] baudRate - line speed, e.g. MODBUS_BAUDRATE
+ *
+ *****************************************************************************/
+void modbus_init (uint8_t slaveAddr, uint32_t baudRate)
+{
+    PINSEL_CFG_Type PinCfg;
+    UART_CFG_Type uartCfg;
+    UART_FIFO_CFG_Type fifoCfg;
+    UART1_RS485_CTRLCFG_Type rs485Cfg;
+    uint32_t lcr;
+
+    slave = slaveAddr;
+    regs[0][MODBUS_REG_VERSION] = MODBUS_VERSION;
+    regs[1][MODBUS_REG_VERSION] = MODBUS_VERSION;
+
+    /* P0.15 - TXD1, P0.16 - RXD1, P0.22 - RTS1 */
+    PinCfg.Funcnum = 1;
+    PinCfg.OpenDrain = 0;
+    PinCfg.Pinmode = 0;
+    PinCfg.Portnum = 0;
+    PinCfg.Pinnum = 15;
+    PINSEL_ConfigPin(&PinCfg);
+    PinCfg.Pinnum = 16;
+    PINSEL_ConfigPin(&PinCfg);
+    PinCfg.Pinnum = 22;
+    PINSEL_ConfigPin(&PinCfg);
+
+    uartCfg.Baud_rate = baudRate;
+    uartCfg.Databits = UART_DATABIT_8;
+    uartCfg.Parity = UART_PARITY_EVEN;
+    uartCfg.Stopbits = UART_STOPBIT_1;
+    UART_Init((LPC_UART_TypeDef *)UARTDEV, &uartCfg);
+
+    /* interrupt on every byte so the gap timer starts when it arrives */
+    UART_FIFOConfigStructInit(&fifoCfg);
+    fifoCfg.FIFO_Level = UART_FIFO_TRGLEV0;
+    UART_FIFOConfig((LPC_UART_TypeDef *)UARTDEV, &fifoCfg);
+
+    /* RTS1 high while transmitting */
+    rs485Cfg.NormalMultiDropMode_State = DISABLE;
+    rs485Cfg.Rx_State = ENABLE;
+    rs485Cfg.AutoAddrDetect_State = DISABLE;
+    rs485Cfg.AutoDirCtrl_State = ENABLE;
+    rs485Cfg.DirCtrlPin = UART1_RS485_DIRCTRL_RTS;
+    rs485Cfg.DirCtrlPol_Level = SET;
+    rs485Cfg.MatchAddrValue = 0;
+    rs485Cfg.DelayValue = 0;
+
+    /* UART_RS485Config sets stick parity for 9-bit mode, keep 8E1 */
+    lcr = UARTDEV->LCR;
+    UART_RS485Config(UARTDEV, &rs485Cfg);
+    UARTDEV->LCR = lcr;
+
+    UART_TxCmd((LPC_UART_TypeDef *)UARTDEV, ENABLE);
+
+    /*
+     * TIMER0 counts us from PCLK = CCLK/4 and stops on MR0. Above 19200
+     * baud the gap is fixed to 1750 us, below it is 3.5 characters of
+     * 11 bits.
+     */
+    LPC_SC->PCONP |= (1 << 1);
+    LPC_SC->PCLKSEL0 &= ~(0x03 << 2);
+    LPC_TIM0->TCR = 0;
+    LPC_TIM0->PR = (SystemCoreClock / 4) / 1000000 - 1;
+    LPC_TIM0->MR0 = (baudRate > 19200) ? 1750 : 38500000 / baudRate;
+    LPC_TIM0->MCR = (1 << 0) | (1 << 1) | (1 << 2);
+    LPC_TIM0->IR = LPC_TIM0->IR;
+
+    UART_IntConfig((LPC_UART_TypeDef *)UARTDEV, UART_INTCFG_RBR, ENABLE);
+    UART_IntConfig((LPC_UART_TypeDef *)UARTDEV, UART_INTCFG_RLS, ENABLE);
+    UART_IntConfig((LPC_UART_TypeDef *)UARTDEV, UART_INTCFG_THRE, ENABLE);
+
+    NVIC_ClearPendingIRQ(TIMER0_IRQn);
+    NVIC_EnableIRQ(TIMER0_IRQn);
+    NVIC_ClearPendingIRQ(UART1_IRQn);
+    NVIC_EnableIRQ(UART1_IRQn);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Change the slave address, from the next request on
+ *
+ * Params:
+ *   [in] slaveAddr - Modbus slave address, 1 to MODBUS_ADDR_MAX
+ *
+ *****************************************************************************/
+void modbus_setAddress (uint8_t slaveAddr)
+{
+    /* one byte, the interrupt sees the old or the new address */
+    slave = slaveAddr;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Publish a new snapshot of the sensor values
+ *
+ * Params:
+ *   [in] temperature - 10 x T(C)
+ *   [in] light - light level in lux
+ *   [in] x, y, z - accelerometer values
+ *   [in] warnings - MODBUS_WARN_x bits
+ *
+ *****************************************************************************/
+void modbus_update (int16_t temperature, uint32_t light,
+        int8_t x, int8_t y, int8_t z, uint8_t warnings)
+{
+    uint16_t *img = regs[!front];
+
+    samples++;
+
+    img[MODBUS_REG_WARNINGS] = warnings;
+    img[MODBUS_REG_TEMP] = (uint16_t)temperature;
+    img[MODBUS_REG_LIGHT_HI] = (uint16_t)(light >> 16);
+    img[MODBUS_REG_LIGHT_LO] = (uint16_t)light;
+    img[MODBUS_REG_ACC_X] = (uint16_t)x;
+    img[MODBUS_REG_ACC_Y] = (uint16_t)y;
+    img[MODBUS_REG_ACC_Z] = (uint16_t)z;
+    img[MODBUS_REG_SAMPLES_HI] = (uint16_t)(samples >> 16);
+    img[MODBUS_REG_SAMPLES_LO] = (uint16_t)samples;
+
+    /* a reply is built in one go in the interrupt, it never sees half */
+    front = !front;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Modbus CRC16 of a block, sent low byte first
+ *
+ *****************************************************************************/
+uint16_t modbus_crc16 (const uint8_t *data, uint32_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    while (len--)
+        crc = (crc >> 8) ^ crcTable[(crc ^ *data++) & 0xFF];
+
+    return crc;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Number of frames dropped for a bad CRC, a UART error or length
+ *
+ *****************************************************************************/
+uint32_t modbus_getErrorCount (void)
+{
+    return errorCount;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    UART1 interrupt: receive bytes and feed the reply to the TX FIFO
+ *
+ *****************************************************************************/
+void UART1_IRQHandler (void)
+{
+    uint32_t iir;
+
+    while (!((iir = UARTDEV->IIR) & UART_IIR_INTSTAT_PEND)) {
+        switch (iir & UART_IIR_INTID_MASK)
+        {
+        case UART_IIR_INTID_RLS:
+        case UART_IIR_INTID_RDA:
+        case UART_IIR_INTID_CTI:
+            receive();
+            break;
+
+        case UART_IIR_INTID_THRE:
+            if (state == STATE_REPLY)
+                fillFifo();
+            break;
+
+        default:
+            /* modem status, not used */
+            (void)UARTDEV->MSR;
+            break;
+        }
+    }
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    TIMER0 interrupt: 3.5 characters of silence, the end of a frame
+ *
+ *****************************************************************************/
+void TIMER0_IRQHandler (void)
+{
+    LPC_TIM0->IR = LPC_TIM0->IR;
+
+    if (state == STATE_RECEIVE)
+        handleFrame();
+    else
+        state = STATE_IDLE;
+}
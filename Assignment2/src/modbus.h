@@ -0,0 +1,55 @@
+/*****************************************************************************
+ *   modbus.h:  Header file for the Modbus RTU slave on UART1 (RS-485)
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __MODBUS_H
+#define __MODBUS_H
+
+#include "lpc_types.h"
+
+/*
+ * Register layout, 16-bit registers. The same read-only registers are
+ * returned for Read Holding Registers (0x03) and Read Input Registers
+ * (0x04). 32-bit values take two registers, high word first.
+ */
+#define MODBUS_REG_VERSION    0   /* layout version, MODBUS_VERSION */
+#define MODBUS_REG_WARNINGS   1   /* MODBUS_WARN_x bits */
+#define MODBUS_REG_TEMP       2   /* int16, 10 x T(C) */
+#define MODBUS_REG_LIGHT_HI   3   /* uint32, lux */
+#define MODBUS_REG_LIGHT_LO   4
+#define MODBUS_REG_ACC_X      5   /* int16 */
+#define MODBUS_REG_ACC_Y      6   /* int16 */
+#define MODBUS_REG_ACC_Z      7   /* int16 */
+#define MODBUS_REG_SAMPLES_HI 8   /* uint32, number of published samples */
+#define MODBUS_REG_SAMPLES_LO 9
+#define MODBUS_NUM_REGS       10
+
+#define MODBUS_VERSION        0x01
+
+#define MODBUS_WARN_HIGH_TEMP 0x01
+#define MODBUS_WARN_MOVEMENT  0x02
+
+/* Default slave address and line speed, 8E1 as the Modbus default */
+#define MODBUS_SLAVE_ADDR     0x01
+#define MODBUS_ADDR_MAX       247 /* 248 and up are reserved */
+#define MODBUS_BAUDRATE       19200
+
+/* Largest RTU frame: address, PDU of up to 253 bytes, CRC */
+#define MODBUS_ADU_MAX        256
+
+
+void modbus_init (uint8_t slaveAddr, uint32_t baudRate);
+void modbus_setAddress (uint8_t slaveAddr);
+void modbus_update (int16_t temperature, uint32_t light,
+        int8_t x, int8_t y, int8_t z, uint8_t warnings);
+uint16_t modbus_crc16 (const uint8_t *data, uint32_t len);
+uint32_t modbus_getErrorCount (void);
+
+
+#endif /* end __MODBUS_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
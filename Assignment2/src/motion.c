@@ -0,0 +1,178 @@
+/*****************************************************************************
+ *   motion.c:  Movement detector for batches of accelerometer samples
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * A sample is handled as one word with x, y and z in the low three bytes,
+ * the way acc_sample_t is laid out. The high-pass difference and its
+ * absolute value are done on all axes at once with byte lane arithmetic
+ * that never carries from one lane into the next. Only a sample with an
+ * axis above the noise level goes on to the magnitude.
+ *
+ * Nothing here touches the hardware, tools/motion_replay.c builds this
+ * file on the host to run recorded traces through it.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <string.h>
+#include "motion.h"
+
+/******************************************************************************
+ * Defines and typedefs
+ *****************************************************************************/
+
+#define LANES_HI    0x80808080
+#define LANES_LO    0x7F7F7F7F
+#define LANES_ONE   0x01010101
+#define LANES_AXES  0x00FFFFFF  /* x, y and z, not the pad byte */
+
+/* b in each of the axis lanes */
+#define LANES(b)    ((uint32_t)(b) * 0x00010101)
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+/* floor((a - b) / 2) in each signed byte lane, this cannot overflow */
+static uint32_t halfSub (uint32_t a, uint32_t b)
+{
+    uint32_t ua = a ^ LANES_HI;     /* biased, a + 128 */
+    uint32_t nb = b ^ LANES_LO;     /* 127 - b */
+
+    /* ceil((ua + nb) / 2) - 128 per lane, the subtraction never borrows */
+    return ((ua | nb) - (((ua ^ nb) >> 1) & LANES_LO)) ^ LANES_HI;
+}
+
+/* |v| in each signed byte lane, -128 gives 128 */
+static uint32_t laneAbs (uint32_t v)
+{
+    uint32_t neg = (v >> 7) & LANES_ONE;
+
+    /* one's complement of the negative lanes plus one, at most 0x80 */
+    return (v ^ (neg * 0xFF)) + neg;
+}
+
+/* Magnitude of a vector from the absolute values of its axes */
+static uint32_t magnitude (uint32_t a)
+{
+    uint32_t x = a & 0xFF;
+    uint32_t y = (a >> 8) & 0xFF;
+    uint32_t z = (a >> 16) & 0xFF;
+    uint32_t t;
+
+    /* sort so that x >= y >= z */
+    if (x < y) { t = x; x = y; y = t; }
+    if (y < z) { t = y; y = z; z = t; }
+    if (x < y) { t = x; x = y; y = t; }
+
+    return x + ((11 * y) >> 5) + (z >> 2);
+}
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Reset the detector. The first sample processed is taken as the DC.
+ *
+ * Params:
+ *   [out] st - detector state
+ *   [in] onLevel - energy at which movement starts
+ *   [in] offLevel - energy below which it stops, at most onLevel
+ *
+ *****************************************************************************/
+void motion_init (motion_state_t *st, uint32_t onLevel, uint32_t offLevel)
+{
+    memset(st, 0, sizeof(*st));
+    st->onLevel = onLevel;
+    st->offLevel = (offLevel > onLevel) ? onLevel : offLevel;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Run a batch of samples through the detector
+ *
+ * Params:
+ *   [in/out] st - detector state
+ *   [in] samples - samples, oldest first
+ *   [in] n - number of samples
+ *
+ * Returns:
+ *    Number of samples for which movement was detected
+ *
+ *****************************************************************************/
+uint32_t motion_process (motion_state_t *st, const acc_sample_t *samples,
+        uint32_t n)
+{
+    uint32_t moving = 0;
+    uint32_t word;
+    uint32_t dcWord;
+    uint32_t a;
+    uint32_t m;
+    uint32_t i;
+
+    if (n > 0 && !st->primed) {
+        st->dc[0] = (int32_t)samples[0].x << 8;
+        st->dc[1] = (int32_t)samples[0].y << 8;
+        st->dc[2] = (int32_t)samples[0].z << 8;
+        st->primed = 1;
+    }
+
+    for (i = 0; i < n; i++) {
+        memcpy(&word, &samples[i], sizeof(word));
+
+        dcWord = ((uint32_t)(st->dc[0] >> 8) & 0xFF)
+                | (((uint32_t)(st->dc[1] >> 8) & 0xFF) << 8)
+                | (((uint32_t)(st->dc[2] >> 8) & 0xFF) << 16);
+
+        st->dc[0] += (((int32_t)samples[i].x << 8) - st->dc[0]) >> MOTION_DC_SHIFT;
+        st->dc[1] += (((int32_t)samples[i].y << 8) - st->dc[1]) >> MOTION_DC_SHIFT;
+        st->dc[2] += (((int32_t)samples[i].z << 8) - st->dc[2]) >> MOTION_DC_SHIFT;
+
+        a = laneAbs(halfSub(word, dcWord)) & LANES_AXES;
+
+        /* a lane goes above 0x7F when it is above the noise level */
+        if (((a + LANES(0x7F - MOTION_QUIET)) & LANES_HI) == 0)
+            m = 0;
+        else
+            m = magnitude(a);
+
+        st->energy -= st->window[st->pos];
+        st->window[st->pos] = (uint16_t)(m * m);
+        st->energy += m * m;
+        st->pos = (st->pos + 1) & (MOTION_WINDOW - 1);
+
+        if (st->active) {
+            if (st->energy < st->offLevel)
+                st->active = 0;
+        } else if (st->energy >= st->onLevel) {
+            st->active = 1;
+        }
+
+        if (st->active)
+            moving++;
+    }
+
+    return moving;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Energy over the last window, for tuning the levels
+ *
+ *****************************************************************************/
+uint32_t motion_getEnergy (const motion_state_t *st)
+{
+    return st->energy;
+}
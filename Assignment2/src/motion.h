@@ -0,0 +1,57 @@
+/*****************************************************************************
+ *   motion.h:  Header file for the accelerometer movement detector
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __MOTION_H
+#define __MOTION_H
+
+#include "lpc_types.h"
+#include "acc.h"
+
+/*
+ * Samples are filtered in three steps:
+ *   - high-pass: an EWMA of each axis (time constant 2^MOTION_DC_SHIFT
+ *     samples) is taken off the sample, in half counts
+ *   - magnitude of the result, max + 11/32 mid + 1/4 min of the axes
+ *   - energy: sum of the squared magnitudes over the last MOTION_WINDOW
+ *     samples, compared with an on and a lower off level
+ * Axes within MOTION_QUIET half counts of the DC are noise and give a
+ * magnitude of 0.
+ */
+#define MOTION_DC_SHIFT   7     /* about 1 s at 125 Hz */
+#define MOTION_WINDOW     16    /* 128 ms at 125 Hz, a power of 2 */
+#define MOTION_QUIET      1
+
+/*
+ * Default levels. 10 counts (5 half counts) on one axis for 4 samples
+ * is 100, the old rule of a change of more than 10 counts.
+ */
+#define MOTION_ON_LEVEL   100
+#define MOTION_OFF_LEVEL  50
+
+typedef struct
+{
+    int32_t dc[3];                  /* Q8 counts */
+    uint16_t window[MOTION_WINDOW]; /* squared magnitudes */
+    uint32_t energy;                /* sum of window */
+    uint32_t pos;
+    uint32_t onLevel;
+    uint32_t offLevel;
+    uint8_t primed;                 /* dc holds the first sample */
+    uint8_t active;
+} motion_state_t;
+
+
+void motion_init (motion_state_t *st, uint32_t onLevel, uint32_t offLevel);
+uint32_t motion_process (motion_state_t *st, const acc_sample_t *samples,
+        uint32_t n);
+uint32_t motion_getEnergy (const motion_state_t *st);
+
+
+#endif /* end __MOTION_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
@@ -0,0 +1,224 @@
+/*****************************************************************************
+ *   regmap.c:  I2C slave register map exposing the latest sensor values
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * The board answers as an I2C slave on I2C1 (P0.19 SDA1, P0.20 SCL1).
+ * Every bus event is handled in I2C1_IRQHandler, the main loop only
+ * publishes a new snapshot with regmap_update().
+ *
+ * Two images of the register map are kept. The ISR always starts a read
+ * burst from the front image and keeps using that image until the burst
+ * ends, so a host never sees half of an update. regmap_update() writes
+ * the back image and then swaps.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "lpc17xx_pinsel.h"
+#include "lpc17xx_i2c.h"
+#include "regmap.h"
+
+/******************************************************************************
+ * Defines and typedefs
+ *****************************************************************************/
+
+#define I2CDEV LPC_I2C1
+
+/* No image is being read by the host */
+#define IMAGE_NONE 0xFF
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+static uint8_t image[2][REGMAP_SIZE];
+
+/* Image new read bursts are served from */
+static volatile uint8_t front = 0;
+
+/* Image latched by the read burst in progress */
+static volatile uint8_t reading = IMAGE_NONE;
+
+/* Register pointer, auto-incremented on every byte sent */
+static uint8_t pointer = 0;
+static uint8_t expectPointer = 0;
+
+static uint32_t samples = 0;
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+static void put16(uint8_t *buf, uint16_t val)
+{
+    buf[0] = (uint8_t)(val & 0xff);
+    buf[1] = (uint8_t)(val >> 8);
+}
+
+static void put32(uint8_t *buf, uint32_t val)
+{
+    buf[0] = (uint8_t)(val & 0xff);
+    buf[1] = (uint8_t)((val >> 8) & 0xff);
+    buf[2] = (uint8_t)((val >> 16) & 0xff);
+    buf[3] = (uint8_t)(val >> 24);
+}
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Configure I2C1 as a slave and start answering on the given address
+ *
+ * Params:
+ *   [in] addr7bit - 7-bit slave address, e.g. REGMAP_I2C_ADDR
+ *
+ *****************************************************************************/
+void regmap_init (uint8_t addr7bit)
+{
+    PINSEL_CFG_Type PinCfg;
+    I2C_OWNSLAVEADDR_CFG_Type addrCfg;
+
+    /* P0.19 - SDA1, P0.20 - SCL1, open drain without pull resistors */
+    PinCfg.Funcnum = 3;
+    PinCfg.OpenDrain = 1;
+    PinCfg.Pinmode = 2;
+    PinCfg.Portnum = 0;
+    PinCfg.Pinnum = 19;
+    PINSEL_ConfigPin(&PinCfg);
+    PinCfg.Pinnum = 20;
+    PINSEL_ConfigPin(&PinCfg);
+
+    image[0][REGMAP_ADDR_VERSION] = REGMAP_VERSION;
+    image[1][REGMAP_ADDR_VERSION] = REGMAP_VERSION;
+
+    I2C_Init(I2CDEV, 100000);
+
+    addrCfg.SlaveAddrChannel = 0;
+    addrCfg.SlaveAddr_7bit = addr7bit;
+    addrCfg.GeneralCallState = DISABLE;
+    addrCfg.SlaveAddrMaskValue = 0x00;
+    I2C_SetOwnSlaveAddr(I2CDEV, &addrCfg);
+
+    I2C_Cmd(I2CDEV, ENABLE);
+
+    /* acknowledge our own address */
+    I2CDEV->I2CONSET = I2C_I2CONSET_AA;
+    I2CDEV->I2CONCLR = I2C_I2CONCLR_SIC | I2C_I2CONCLR_STAC;
+
+    NVIC_ClearPendingIRQ(I2C1_IRQn);
+    NVIC_EnableIRQ(I2C1_IRQn);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Publish a new snapshot of the sensor values
+ *
+ * Params:
+ *   [in] temperature - 10 x T(C)
+ *   [in] light - light level in lux
+ *   [in] x, y, z - accelerometer values
+ *   [in] warnings - REGMAP_WARN_x bits
+ *
+ * Returns:
+ *    SUCCESS, or ERROR if the host is still reading the back image. The
+ *    snapshot is dropped in that case; the next update will go through.
+ *
+ *****************************************************************************/
+Status regmap_update (int16_t temperature, uint32_t light,
+		int8_t x, int8_t y, int8_t z, uint8_t warnings)
+{
+    uint8_t back = !front;
+    uint8_t *img = image[back];
+
+    if (reading == back)
+        return ERROR;
+
+    samples++;
+
+    img[REGMAP_ADDR_WARNINGS] = warnings;
+    put16(&img[REGMAP_ADDR_TEMP], (uint16_t)temperature);
+    put32(&img[REGMAP_ADDR_LIGHT], light);
+    img[REGMAP_ADDR_ACC_X] = (uint8_t)x;
+    img[REGMAP_ADDR_ACC_Y] = (uint8_t)y;
+    img[REGMAP_ADDR_ACC_Z] = (uint8_t)z;
+    put32(&img[REGMAP_ADDR_SAMPLES], samples);
+
+    front = back;
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    I2C1 slave state machine. Every status code is answered without
+ *    waiting, the register map is read-only.
+ *
+ *****************************************************************************/
+void I2C1_IRQHandler (void)
+{
+    uint8_t data;
+
+    switch (I2CDEV->I2STAT & I2C_STAT_CODE_BITMASK)
+    {
+    /* Own SLA+W: the first data byte is the register address */
+    case I2C_I2STAT_S_RX_SLAW_ACK:
+        expectPointer = 1;
+        break;
+
+    case I2C_I2STAT_S_RX_PRE_SLA_DAT_ACK:
+        data = (uint8_t)I2CDEV->I2DAT;
+        if (expectPointer) {
+            pointer = data;
+            expectPointer = 0;
+        }
+        break;
+
+    case I2C_I2STAT_S_RX_PRE_SLA_DAT_NACK:
+    case I2C_I2STAT_S_RX_STA_STO_SLVREC_SLVTRX:
+        expectPointer = 0;
+        break;
+
+    /* Own SLA+R: latch the image for the whole burst */
+    case I2C_I2STAT_S_TX_SLAR_ACK:
+        reading = front;
+        /* fall through */
+    case I2C_I2STAT_S_TX_DAT_ACK:
+        if (pointer < REGMAP_SIZE) {
+            I2CDEV->I2DAT = image[reading][pointer];
+            pointer++;
+        }
+        else {
+            I2CDEV->I2DAT = I2C_I2DAT_IDLE_CHAR;
+        }
+        break;
+
+    /* Host has NACKed, end of the read burst */
+    case I2C_I2STAT_S_TX_DAT_NACK:
+    case I2C_I2STAT_S_TX_LAST_DAT_ACK:
+        reading = IMAGE_NONE;
+        break;
+
+    /* Bus error: STO resets the controller to not addressed slave */
+    default:
+        I2CDEV->I2CONSET = I2C_I2CONSET_STO;
+        reading = IMAGE_NONE;
+        expectPointer = 0;
+        break;
+    }
+
+    /* stay addressable and release the bus */
+    I2CDEV->I2CONSET = I2C_I2CONSET_AA;
+    I2CDEV->I2CONCLR = I2C_I2CONCLR_SIC;
+}
@@ -0,0 +1,46 @@
+/*****************************************************************************
+ *   regmap.h:  Header file for the I2C slave register map
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __REGMAP_H
+#define __REGMAP_H
+
+#include "lpc_types.h"
+
+/*
+ * Register layout seen by the external host. Multi-byte values are
+ * little endian. Write one byte (the register address) to move the
+ * read pointer, then read any number of bytes in one burst. The pointer
+ * auto-increments; reads beyond the end return 0xFF.
+ */
+#define REGMAP_ADDR_VERSION   0x00  /* layout version, REGMAP_VERSION */
+#define REGMAP_ADDR_WARNINGS  0x01  /* REGMAP_WARN_x bits */
+#define REGMAP_ADDR_TEMP      0x02  /* int16, 10 x T(C) */
+#define REGMAP_ADDR_LIGHT     0x04  /* uint32, lux */
+#define REGMAP_ADDR_ACC_X     0x08  /* int8 */
+#define REGMAP_ADDR_ACC_Y     0x09  /* int8 */
+#define REGMAP_ADDR_ACC_Z     0x0A  /* int8 */
+#define REGMAP_ADDR_SAMPLES   0x0C  /* uint32, number of published samples */
+#define REGMAP_SIZE           0x10
+
+#define REGMAP_VERSION        0x01
+
+#define REGMAP_WARN_HIGH_TEMP 0x01
+#define REGMAP_WARN_MOVEMENT  0x02
+
+/* Default 7-bit slave address of the board */
+#define REGMAP_I2C_ADDR       0x3C
+
+
+void regmap_init (uint8_t addr7bit);
+Status regmap_update (int16_t temperature, uint32_t light,
+		int8_t x, int8_t y, int8_t z, uint8_t warnings);
+
+
+#endif /* end __REGMAP_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
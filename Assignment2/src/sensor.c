@@ -0,0 +1,325 @@
+/*****************************************************************************
+ *   sensor.c:  Descriptor driven sensor acquisition
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * Each sensor is described by a sensor_desc_t with its hooks and rates.
+ * sensor_poll() is called from the main loop with the ms tick. A started
+ * sensor is read when its period has passed, the reads are averaged over
+ * the decimation, and the converted sample goes to every consumer of the
+ * sensor with the time of its last read. Consumers run in the main loop.
+ *
+ * A read that starts more than the sensor's latency after it was due is
+ * counted as late, the main loop was busy elsewhere for too long. The next
+ * read is then due one period after this one, late reads are not caught
+ * up.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "sensor.h"
+
+/******************************************************************************
+ * Defines and typedefs
+ *****************************************************************************/
+
+typedef struct
+{
+    const sensor_desc_t *desc;
+    uint32_t period;
+    uint32_t due;       /* ms tick of the next read */
+    uint32_t late;
+    int32_t sum[SENSOR_MAX_VALUES];
+    uint16_t reads;     /* reads in sum */
+    uint8_t count;
+    uint8_t active;
+} sensor_t;
+
+typedef struct
+{
+    uint8_t id;
+    sensor_consumer_t fn;
+} consumer_t;
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+static sensor_t sensors[SENSOR_MAX];
+static uint32_t numSensors = 0;
+
+static consumer_t consumers[SENSOR_MAX_CONSUMERS];
+static uint32_t numConsumers = 0;
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+static int validId (int32_t id)
+{
+    return id >= 0 && (uint32_t)id < numSensors;
+}
+
+/* Average the reads, convert and hand the sample to the consumers */
+static void publish (int32_t id, uint32_t time)
+{
+    sensor_t *s = &sensors[id];
+    sensor_sample_t sample;
+    uint32_t i;
+
+    sample.id = (uint8_t)id;
+    sample.count = s->count;
+    sample.time = time;
+    for (i = 0; i < s->count; i++) {
+        sample.value[i] = s->sum[i] / (int32_t)s->reads;
+        s->sum[i] = 0;
+    }
+    s->reads = 0;
+
+    if (s->desc->convert != NULL)
+        s->desc->convert(sample.value, sample.count);
+
+    for (i = 0; i < numConsumers; i++) {
+        if (consumers[i].id == id)
+            consumers[i].fn(&sample);
+    }
+}
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Add a sensor and run its init hook. It is not read until started.
+ *
+ * Params:
+ *   [in] desc - descriptor, must stay valid
+ *
+ * Returns:
+ *    Id of the sensor, -1 if the registry is full, the descriptor is not
+ *    valid or the init hook failed
+ *
+ *****************************************************************************/
+int32_t sensor_register (const sensor_desc_t *desc)
+{
+    sensor_t *s;
+
+    if (numSensors == SENSOR_MAX || desc->read == NULL
+            || desc->decimation == 0)
+        return -1;
+
+    if (desc->init != NULL && desc->init() != 0)
+        return -1;
+
+    s = &sensors[numSensors];
+    s->desc = desc;
+    s->period = desc->period;
+    s->late = 0;
+    s->reads = 0;
+    s->active = 0;
+
+    return numSensors++;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Hand the samples of a sensor to a consumer
+ *
+ * Returns:
+ *    0 on success, -1 if the id is not valid or there is no room
+ *
+ *****************************************************************************/
+int32_t sensor_subscribe (int32_t id, sensor_consumer_t consumer)
+{
+    if (!validId(id) || numConsumers == SENSOR_MAX_CONSUMERS)
+        return -1;
+
+    consumers[numConsumers].id = (uint8_t)id;
+    consumers[numConsumers].fn = consumer;
+    numConsumers++;
+
+    return 0;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Run the start hook and read the sensor from one period after now
+ *
+ *****************************************************************************/
+void sensor_start (int32_t id, uint32_t now)
+{
+    sensor_t *s;
+    uint32_t i;
+
+    if (!validId(id))
+        return;
+
+    s = &sensors[id];
+    if (s->desc->start != NULL)
+        s->desc->start();
+
+    for (i = 0; i < SENSOR_MAX_VALUES; i++)
+        s->sum[i] = 0;
+    s->reads = 0;
+    s->due = now + s->period;
+    s->active = 1;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Stop reading the sensor and run the stop hook, a partly averaged
+ *    sample is dropped
+ *
+ *****************************************************************************/
+void sensor_stop (int32_t id)
+{
+    if (!validId(id))
+        return;
+
+    sensors[id].active = 0;
+    if (sensors[id].desc->stop != NULL)
+        sensors[id].desc->stop();
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Change the period of a sensor, from the next read on
+ *
+ * Returns:
+ *    0 on success, -1 if the id is not valid
+ *
+ *****************************************************************************/
+int32_t sensor_setPeriod (int32_t id, uint32_t period)
+{
+    sensor_t *s;
+
+    if (!validId(id))
+        return -1;
+
+    s = &sensors[id];
+    s->due = s->due - s->period + period;
+    s->period = period;
+
+    return 0;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Read the sensors that are due, call it from the main loop
+ *
+ * Params:
+ *   [in] now - ms tick
+ *
+ *****************************************************************************/
+void sensor_poll (uint32_t now)
+{
+    int32_t raw[SENSOR_MAX_VALUES];
+    sensor_t *s;
+    uint32_t id;
+    uint32_t i;
+    uint8_t n;
+
+    for (id = 0; id < numSensors; id++) {
+        s = &sensors[id];
+
+        /* the tick wraps, compare the difference */
+        if (!s->active || (int32_t)(now - s->due) < 0)
+            continue;
+
+        if (now - s->due > s->desc->latency)
+            s->late++;
+        s->due = now + s->period;
+
+        n = s->desc->read(raw);
+        if (n == 0)
+            continue;
+        if (n > SENSOR_MAX_VALUES)
+            n = SENSOR_MAX_VALUES;
+
+        for (i = 0; i < n; i++)
+            s->sum[i] += raw[i];
+        s->count = n;
+
+        if (++s->reads == s->desc->decimation)
+            publish(id, now);
+    }
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Find when the next read of any started sensor is due
+ *
+ * Params:
+ *   [in] now - ms tick
+ *   [out] due - ms tick of the next read, it may be before now
+ *
+ * Returns:
+ *    0 on success, -1 if no sensor is started
+ *
+ *****************************************************************************/
+int32_t sensor_nextDue (uint32_t now, uint32_t *due)
+{
+    int32_t found = -1;
+    uint32_t id;
+
+    for (id = 0; id < numSensors; id++) {
+        if (!sensors[id].active)
+            continue;
+
+        /* the tick wraps, compare the time left */
+        if (found != 0 || (int32_t)(sensors[id].due - now)
+                < (int32_t)(*due - now)) {
+            *due = sensors[id].due;
+            found = 0;
+        }
+    }
+
+    return found;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Number of registered sensors, the ids are 0 to this minus 1
+ *
+ *****************************************************************************/
+uint32_t sensor_count (void)
+{
+    return numSensors;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Name of a sensor, NULL if the id is not valid
+ *
+ *****************************************************************************/
+const char *sensor_getName (int32_t id)
+{
+    return validId(id) ? sensors[id].desc->name : NULL;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Number of reads that started later than the sensor's latency allows
+ *
+ *****************************************************************************/
+uint32_t sensor_getLateCount (int32_t id)
+{
+    return validId(id) ? sensors[id].late : 0;
+}
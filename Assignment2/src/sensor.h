@@ -0,0 +1,67 @@
+/*****************************************************************************
+ *   sensor.h:  Header file for the descriptor driven sensor registry
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __SENSOR_H
+#define __SENSOR_H
+
+#include "lpc_types.h"
+
+#define SENSOR_MAX              6   /* sensors in the registry */
+#define SENSOR_MAX_CONSUMERS    8   /* consumers of all sensors together */
+#define SENSOR_MAX_VALUES       3   /* values of one sample, e.g. x, y, z */
+
+typedef struct
+{
+    uint8_t id;
+    uint8_t count;                      /* values used */
+    uint32_t time;                      /* ms tick of the last read */
+    int32_t value[SENSOR_MAX_VALUES];   /* converted */
+} sensor_sample_t;
+
+/*
+ * One per sensor, normally const. Only read is required.
+ *   init     - once at registration, 0 on success
+ *   start    - when the sensor is started
+ *   stop     - when the sensor is stopped
+ *   read     - take the raw values, returns how many, 0 if none is ready
+ *   convert  - raw values, averaged over the decimation, to units in place
+ *   period   - ms from one read to the next
+ *   decimation - reads averaged into one sample, at least 1
+ *   latency  - ms a read may start after it is due before it is late
+ */
+typedef struct
+{
+    const char *name;
+    int32_t (*init)(void);
+    void (*start)(void);
+    void (*stop)(void);
+    uint8_t (*read)(int32_t *raw);
+    void (*convert)(int32_t *value, uint8_t count);
+    uint32_t period;
+    uint16_t decimation;
+    uint32_t latency;
+} sensor_desc_t;
+
+typedef void (*sensor_consumer_t)(const sensor_sample_t *sample);
+
+
+int32_t sensor_register (const sensor_desc_t *desc);
+int32_t sensor_subscribe (int32_t id, sensor_consumer_t consumer);
+void sensor_start (int32_t id, uint32_t now);
+void sensor_stop (int32_t id);
+int32_t sensor_setPeriod (int32_t id, uint32_t period);
+void sensor_poll (uint32_t now);
+int32_t sensor_nextDue (uint32_t now, uint32_t *due);
+uint32_t sensor_count (void);
+const char *sensor_getName (int32_t id);
+uint32_t sensor_getLateCount (int32_t id);
+
+
+#endif /* end __SENSOR_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
@@ -0,0 +1,277 @@
+/*****************************************************************************
+ *   shell.c:  Line based command shell on the UART3 terminal
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * NOTE: uart_init() must have been called before the shell is used.
+ *
+ * shell_poll() is called from the main loop. It takes whatever the
+ * receive interrupt has buffered, echoes it, and runs a command once a
+ * CR or LF completes the line. Command handlers run in the main loop, not
+ * in interrupt context, and must not block.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <string.h>
+#include "fmt.h"
+#include "uart.h"
+#include "shell.h"
+
+/******************************************************************************
+ * Defines and typedefs
+ *****************************************************************************/
+
+#define CHAR_BS  0x08
+#define CHAR_DEL 0x7F
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+static const shell_cmd_t *commands = NULL;
+static uint32_t numCommands = 0;
+
+static char line[SHELL_LINE_LEN + 1];
+static uint32_t lineLen = 0;
+
+/* Set when the line got too long, the rest of it is ignored */
+static uint8_t lineOverflow = 0;
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+static void printHelp (void)
+{
+    uint32_t i;
+
+    for (i = 0; i < numCommands; i++) {
+        shell_print(commands[i].name);
+        shell_print(" - ");
+        shell_print(commands[i].help);
+        shell_print("\r\n");
+    }
+}
+
+/* Split the line into words in place and run the matching command */
+static void runLine (void)
+{
+    char *argv[SHELL_MAX_ARGS];
+    int argc = 0;
+    char *p = line;
+    uint32_t i;
+
+    while (*p != '\0') {
+        while (*p == ' ')
+            *p++ = '\0';
+        if (*p == '\0')
+            break;
+        if (argc == SHELL_MAX_ARGS) {
+            shell_print("error: too many arguments\r\n");
+            return;
+        }
+        argv[argc++] = p;
+        while (*p != '\0' && *p != ' ')
+            p++;
+    }
+
+    if (argc == 0)
+        return;
+
+    if (strcmp(argv[0], "help") == 0) {
+        printHelp();
+        return;
+    }
+
+    for (i = 0; i < numCommands; i++) {
+        if (strcmp(argv[0], commands[i].name) == 0) {
+            commands[i].run(argc, argv);
+            return;
+        }
+    }
+
+    shell_print("error: unknown command, try help\r\n");
+}
+
+static void handleChar (uint8_t c)
+{
+    if (c == '\r' || c == '\n') {
+        /* CR LF sends two terminators, the empty second line is ignored */
+        if (lineLen == 0 && !lineOverflow)
+            return;
+        shell_print("\r\n");
+        line[lineLen] = '\0';
+        if (lineOverflow)
+            shell_print("error: line too long\r\n");
+        else
+            runLine();
+        lineLen = 0;
+        lineOverflow = 0;
+        shell_print("> ");
+        return;
+    }
+
+    if (c == CHAR_BS || c == CHAR_DEL) {
+        if (lineLen > 0) {
+            lineLen--;
+            shell_print("\b \b");
+        }
+        return;
+    }
+
+    /* ignore other control characters, e.g. from cursor keys */
+    if (c < ' ' || c > '~')
+        return;
+
+    if (lineLen < SHELL_LINE_LEN) {
+        line[lineLen++] = c;
+        uart_write(&c, 1);
+    } else {
+        lineOverflow = 1;
+    }
+}
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Install the command table
+ *
+ * Params:
+ *   [in] cmds - commands, must stay valid while the shell is used
+ *   [in] numCmds - number of entries in cmds
+ *
+ *****************************************************************************/
+void shell_init (const shell_cmd_t *cmds, uint32_t numCmds)
+{
+    commands = cmds;
+    numCommands = numCmds;
+    lineLen = 0;
+    lineOverflow = 0;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Process received characters, run a command when a line is complete
+ *
+ *****************************************************************************/
+void shell_poll (void)
+{
+    uint8_t buf[16];
+    uint32_t n;
+    uint32_t i;
+
+    while ((n = uart_read(buf, sizeof(buf))) > 0) {
+        for (i = 0; i < n; i++)
+            handleChar(buf[i]);
+    }
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Send a string to the terminal
+ *
+ *****************************************************************************/
+void shell_print (const char *str)
+{
+    uart_writeString(str);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Send "<label> <value>" and a line end
+ *
+ * Params:
+ *   [in] label - name of the value
+ *   [in] value - value scaled by 10^decimals
+ *   [in] decimals - digits after the decimal point
+ *
+ *****************************************************************************/
+void shell_printValue (const char *label, int32_t value, uint8_t decimals)
+{
+    char buf[SHELL_LINE_LEN + FMT_INT_MAX_LEN + 4];
+    uint32_t len = 0;
+    const char *p = label;
+
+    /* leave room for the value even if the label is too long */
+    while (*p != '\0' && len < SHELL_LINE_LEN)
+        buf[len++] = *p++;
+    buf[len++] = ' ';
+    len += fmt_fixed(buf + len, value, decimals);
+    len += fmt_string(buf + len, "\r\n");
+
+    uart_write((uint8_t *)buf, len);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Parse a decimal number such as "-12" or "26.5" into a value scaled by
+ *    10^decimals. Extra fraction digits are cut off.
+ *
+ * Params:
+ *   [in] str - text to parse
+ *   [in] decimals - digits after the decimal point to keep
+ *   [out] value - parsed value
+ *
+ * Returns:
+ *    0 on success, -1 if str is not a number or does not fit
+ *
+ *****************************************************************************/
+int32_t shell_parseValue (const char *str, uint8_t decimals, int32_t *value)
+{
+    uint32_t mag = 0;
+    uint8_t negative = 0;
+    uint8_t digits = 0;
+    uint8_t fraction = 0;
+    uint8_t inFraction = 0;
+
+    if (*str == '-') {
+        negative = 1;
+        str++;
+    }
+
+    for (; *str != '\0'; str++) {
+        if (*str == '.' && !inFraction) {
+            inFraction = 1;
+            continue;
+        }
+        if (*str < '0' || *str > '9')
+            return -1;
+        digits++;
+        if (inFraction) {
+            if (fraction == decimals)
+                continue;
+            fraction++;
+        }
+        if (mag > (0x7FFFFFFF - 9) / 10)
+            return -1;
+        mag = mag * 10 + (*str - '0');
+    }
+
+    if (digits == 0)
+        return -1;
+
+    for (; fraction < decimals; fraction++) {
+        if (mag > 0x7FFFFFFF / 10)
+            return -1;
+        mag *= 10;
+    }
+
+    *value = negative ? -(int32_t)mag : (int32_t)mag;
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+/*****************************************************************************
+ *   shell.h:  Header file for the line based UART command shell
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __SHELL_H
+#define __SHELL_H
+
+#include "lpc_types.h"
+
+/* Longest accepted command line, without the terminating CR/LF */
+#define SHELL_LINE_LEN 48
+
+/* Most words in one command line, the command name included */
+#define SHELL_MAX_ARGS 4
+
+typedef struct
+{
+    const char *name;
+    const char *help;   /* one line, shown by "help" */
+    void (*run)(int argc, char *argv[]);
+} shell_cmd_t;
+
+
+void shell_init (const shell_cmd_t *cmds, uint32_t numCmds);
+void shell_poll (void);
+void shell_print (const char *str);
+void shell_printValue (const char *label, int32_t value, uint8_t decimals);
+int32_t shell_parseValue (const char *str, uint8_t decimals, int32_t *value);
+
+
+#endif /* end __SHELL_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
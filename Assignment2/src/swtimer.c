@@ -0,0 +1,353 @@
+/*****************************************************************************
+ *   swtimer.c:  Software timers multiplexed on TIMER1
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * TIMER1 counts free running in ms and the timers are kept in a
+ * hierarchical wheel in that time. A timer goes into the slot of the
+ * lowest level that reaches its expiry, so starting and stopping one is a
+ * list insert or unlink. When level 0 comes round to slot 0, the current
+ * slot of level 1 is sorted down into level 0, and every 64th time the
+ * current slot of level 2 into level 1.
+ *
+ * MR0 is set to the next expiry in level 0, or to the next wrap of level
+ * 0 if only the higher levels hold timers. The match interrupt expires
+ * the timers up to the counter, skipping empty slots, and sets MR0 again.
+ * Without timers the match interrupt is off, an idle wheel costs nothing.
+ *
+ * The call-backs run in the TIMER1 interrupt and may start and stop
+ * timers, their own one too.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "lpc17xx_clkpwr.h"
+#include "lpc17xx_timer.h"
+#include "swtimer.h"
+
+/******************************************************************************
+ * Defines and typedefs
+ *****************************************************************************/
+
+#define L0_SIZE     (1UL << SWTIMER_L0_BITS)
+#define L1_SIZE     (1UL << SWTIMER_L1_BITS)
+#define L2_SIZE     (1UL << SWTIMER_L2_BITS)
+
+#define L1_SHIFT    SWTIMER_L0_BITS
+#define L2_SHIFT    (SWTIMER_L0_BITS + SWTIMER_L1_BITS)
+#define MAX_SHIFT   (L2_SHIFT + SWTIMER_L2_BITS)
+
+/* First slot of each level in wheel[] */
+#define L1_FIRST    L0_SIZE
+#define L2_FIRST    (L0_SIZE + L1_SIZE)
+#define NUM_SLOTS   (L0_SIZE + L1_SIZE + L2_SIZE)
+
+#define L0_WORDS    (L0_SIZE / 32)
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+static swtimer_t *wheel[NUM_SLOTS];
+
+/* One bit per slot, set when the slot holds a timer */
+static uint32_t used[NUM_SLOTS / 32];
+
+/* Next ms to expire, everything before it has run */
+static uint32_t base = 0;
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+static uint16_t slotFor (uint32_t expires)
+{
+    uint32_t delta = expires - base;
+
+    /* already due, expire with the next ms */
+    if ((int32_t)delta < 0)
+        return base & (L0_SIZE - 1);
+
+    if (delta < (1UL << L1_SHIFT))
+        return expires & (L0_SIZE - 1);
+
+    if (delta < (1UL << L2_SHIFT))
+        return L1_FIRST + ((expires >> L1_SHIFT) & (L1_SIZE - 1));
+
+    if (delta >= (1UL << MAX_SHIFT))
+        expires = base + (1UL << MAX_SHIFT) - 1;
+
+    return L2_FIRST + ((expires >> L2_SHIFT) & (L2_SIZE - 1));
+}
+
+static void insert (swtimer_t *t)
+{
+    uint16_t s = slotFor(t->expires);
+
+    t->slot = s;
+    t->next = wheel[s];
+    t->pprev = &wheel[s];
+    if (t->next != NULL)
+        t->next->pprev = &t->next;
+    wheel[s] = t;
+    used[s >> 5] |= (1UL << (s & 31));
+}
+
+static void unlink (swtimer_t *t)
+{
+    *t->pprev = t->next;
+    if (t->next != NULL)
+        t->next->pprev = t->pprev;
+
+    if (wheel[t->slot] == NULL)
+        used[t->slot >> 5] &= ~(1UL << (t->slot & 31));
+}
+
+/* Sort the timers of a higher level slot into the lower levels */
+static void cascade (uint16_t s)
+{
+    swtimer_t *t = wheel[s];
+    swtimer_t *next;
+
+    wheel[s] = NULL;
+    used[s >> 5] &= ~(1UL << (s & 31));
+
+    while (t != NULL) {
+        next = t->next;
+        insert(t);
+        t = next;
+    }
+}
+
+/* First used level 0 slot from idx on, -1 if none */
+static int32_t nextUsed (uint32_t idx)
+{
+    uint32_t w = idx >> 5;
+    uint32_t bits = used[w] & (0xFFFFFFFFUL << (idx & 31));
+
+    while (1) {
+        if (bits != 0)
+            return (w << 5) + __builtin_ctz(bits);
+        if (++w == L0_WORDS)
+            return -1;
+        bits = used[w];
+    }
+}
+
+static int anyUsed (void)
+{
+    uint32_t i;
+
+    for (i = 0; i < NUM_SLOTS / 32; i++) {
+        if (used[i] != 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Expire every timer due up to and including now */
+static void advance (uint32_t now)
+{
+    swtimer_t *list;
+    swtimer_t *t;
+    uint32_t idx;
+    uint32_t step;
+    int32_t j;
+
+    while ((int32_t)(now - base) >= 0) {
+        idx = base & (L0_SIZE - 1);
+
+        if (idx == 0) {
+            if ((base & ((1UL << L2_SHIFT) - 1)) == 0)
+                cascade(L2_FIRST + ((base >> L2_SHIFT) & (L2_SIZE - 1)));
+            cascade(L1_FIRST + ((base >> L1_SHIFT) & (L1_SIZE - 1)));
+        }
+
+        /* skip to the next used slot or the next wrap */
+        j = nextUsed(idx);
+        step = (j < 0) ? L0_SIZE - idx : (uint32_t)j - idx;
+        if (step > 0) {
+            if (step > now - base + 1)
+                step = now - base + 1;
+            base += step;
+            continue;
+        }
+
+        /* take the slot, what the call-backs start now goes elsewhere */
+        list = wheel[idx];
+        wheel[idx] = NULL;
+        used[idx >> 5] &= ~(1UL << (idx & 31));
+        list->pprev = &list;
+        base++;
+
+        while ((t = list) != NULL) {
+            unlink(t);
+            t->active = 0;
+            if (t->period != 0) {
+                t->expires += t->period;
+                insert(t);
+                t->active = 1;
+            }
+            t->fn();
+        }
+    }
+}
+
+/*
+ * Set MR0 to the next expiry, or turn the match interrupt off without
+ * timers. Returns 1 if that time has passed already.
+ */
+static int program (void)
+{
+    uint32_t idx = base & (L0_SIZE - 1);
+    uint32_t when;
+    int32_t j;
+
+    if (!anyUsed()) {
+        LPC_TIM1->MCR &= ~TIM_INT_ON_MATCH(0);
+        return 0;
+    }
+
+    /* base on a wrap has not cascaded yet */
+    j = (idx == 0) ? 0 : nextUsed(idx);
+    if (j >= 0)
+        when = base + (uint32_t)j - idx;
+    else
+        when = (base | (L0_SIZE - 1)) + 1;
+
+    LPC_TIM1->MR0 = when;
+    LPC_TIM1->MCR |= TIM_INT_ON_MATCH(0);
+
+    return (int32_t)(LPC_TIM1->TC - when) >= 0;
+}
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Start TIMER1 counting in ms
+ *
+ *****************************************************************************/
+void swtimer_init (void)
+{
+    CLKPWR_ConfigPPWR(CLKPWR_PCONP_PCTIM1, ENABLE);
+
+    LPC_TIM1->TCR = 0;
+    LPC_TIM1->MCR = 0;
+    LPC_TIM1->PR = CLKPWR_GetPCLK(CLKPWR_PCLKSEL_TIMER1) / 1000 - 1;
+    LPC_TIM1->TC = 0;
+    LPC_TIM1->PC = 0;
+    LPC_TIM1->IR = LPC_TIM1->IR;
+    base = 0;
+    LPC_TIM1->TCR = TIM_ENABLE;
+
+    NVIC_EnableIRQ(TIMER1_IRQn);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Start a timer, or start it again if it is running
+ *
+ * Params:
+ *   [in] t - timer, must stay valid while it runs
+ *   [in] delay - ms to the first expiry, at least 1 ms passes
+ *   [in] period - ms from one expiry to the next, 0 for one expiry
+ *   [in] fn - call-back, runs in interrupt context
+ *
+ *****************************************************************************/
+void swtimer_start (swtimer_t *t, uint32_t delay, uint32_t period,
+        void (*fn)(void))
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t now;
+
+    __disable_irq();
+
+    if (t->active)
+        unlink(t);
+
+    now = LPC_TIM1->TC;
+
+    /* an empty wheel is not kept up to date */
+    if (!anyUsed())
+        base = now + 1;
+
+    t->expires = now + delay;
+    t->period = period;
+    t->fn = fn;
+    t->active = 1;
+    insert(t);
+
+    if (program())
+        NVIC_SetPendingIRQ(TIMER1_IRQn);
+
+    __set_PRIMASK(primask);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Stop a timer, it does nothing if it is not running
+ *
+ *****************************************************************************/
+void swtimer_stop (swtimer_t *t)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    if (t->active) {
+        unlink(t);
+        t->active = 0;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Check if a timer is running
+ *
+ *****************************************************************************/
+int32_t swtimer_isActive (const swtimer_t *t)
+{
+    return t->active;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    ms count of TIMER1
+ *
+ *****************************************************************************/
+uint32_t swtimer_now (void)
+{
+    return LPC_TIM1->TC;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    TIMER1 interrupt, MR0 matched the next expiry
+ *
+ *****************************************************************************/
+void TIMER1_IRQHandler (void)
+{
+    LPC_TIM1->IR = LPC_TIM1->IR;
+
+    do {
+        advance(LPC_TIM1->TC);
+    } while (program());
+}
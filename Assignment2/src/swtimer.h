@@ -0,0 +1,49 @@
+/*****************************************************************************
+ *   swtimer.h:  Header file for the software timers on TIMER1
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __SWTIMER_H
+#define __SWTIMER_H
+
+#include "lpc_types.h"
+
+/*
+ * Wheel levels, in ms:
+ *   level 0 - 256 slots of 1 ms
+ *   level 1 - 64 slots of 256 ms, up to about 16 s ahead
+ *   level 2 - 64 slots of 16.4 s, up to about 17 minutes ahead
+ * Timers further ahead wait in the last slot of level 2 and are sorted
+ * again when it comes up.
+ */
+#define SWTIMER_L0_BITS 8
+#define SWTIMER_L1_BITS 6
+#define SWTIMER_L2_BITS 6
+
+/* Owned by the caller, the fields are private to swtimer.c */
+typedef struct swtimer
+{
+    struct swtimer *next;
+    struct swtimer **pprev;     /* the pointer that points at this timer */
+    uint32_t expires;           /* ms */
+    uint32_t period;            /* ms, 0 for a one-shot timer */
+    void (*fn)(void);
+    uint16_t slot;
+    uint8_t active;
+} swtimer_t;
+
+
+void swtimer_init (void);
+void swtimer_start (swtimer_t *t, uint32_t delay, uint32_t period,
+        void (*fn)(void));
+void swtimer_stop (swtimer_t *t);
+int32_t swtimer_isActive (const swtimer_t *t);
+uint32_t swtimer_now (void);
+
+
+#endif /* end __SWTIMER_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
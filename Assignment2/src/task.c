@@ -0,0 +1,142 @@
+/*****************************************************************************
+ *   task.c:  Stackless cooperative task scheduler
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * The tasks run in the order they were added, all on the main stack. The
+ * main loop calls task_run() with the events it took from event_wait(),
+ * and every task that can go on runs until its next wait:
+ *   - a task waiting for events, when one of them is in the set
+ *   - a sleeping task, when its time has come
+ *   - any other task, to check its condition or after a yield
+ * A task's time is only checked when the main loop wakes. task_nextWake()
+ * gives the main loop the earliest one, so it can have itself woken then.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "task.h"
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+static task_t *first = NULL;
+static task_t *last = NULL;
+
+static uint32_t now = 0;
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Add a task, it starts from the beginning the next time the tasks run
+ *
+ * Params:
+ *   [in] t - task state, must stay valid
+ *   [in] run - the task function
+ *
+ *****************************************************************************/
+void task_add (task_t *t, int8_t (*run)(task_t *t))
+{
+    t->lc = 0;
+    t->timed = 0;
+    t->ended = 0;
+    t->waitEvents = 0;
+    t->events = 0;
+    t->run = run;
+    t->next = NULL;
+
+    if (last == NULL)
+        first = t;
+    else
+        last->next = t;
+    last = t;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Run the tasks that can go on, call it from the main loop
+ *
+ * Params:
+ *   [in] events - EV_x bits posted since the last call
+ *   [in] ms - ms tick
+ *
+ *****************************************************************************/
+void task_run (uint32_t events, uint32_t ms)
+{
+    task_t *t;
+
+    now = ms;
+
+    for (t = first; t != NULL; t = t->next) {
+        if (t->ended)
+            continue;
+
+        if (t->waitEvents != 0) {
+            t->events = events & t->waitEvents;
+            if (t->events == 0)
+                continue;
+        } else if (t->timed) {
+            /* the tick wraps, compare the difference */
+            if ((int32_t)(now - t->wakeAt) < 0)
+                continue;
+            t->timed = 0;
+        }
+
+        if (t->run(t) == TASK_ENDED)
+            t->ended = 1;
+    }
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Find when the first sleeping task is to be run
+ *
+ * Params:
+ *   [out] at - ms tick to run it, it may have passed
+ *
+ * Returns:
+ *    0 on success, -1 if no task sleeps
+ *
+ *****************************************************************************/
+int32_t task_nextWake (uint32_t *at)
+{
+    int32_t found = -1;
+    task_t *t;
+
+    for (t = first; t != NULL; t = t->next) {
+        if (t->ended || !t->timed)
+            continue;
+
+        /* the tick wraps, compare the time left */
+        if (found != 0 || (int32_t)(t->wakeAt - now) < (int32_t)(*at - now)) {
+            *at = t->wakeAt;
+            found = 0;
+        }
+    }
+
+    return found;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    ms tick of the current task_run() call, for TASK_SLEEP
+ *
+ *****************************************************************************/
+uint32_t task_now (void)
+{
+    return now;
+}
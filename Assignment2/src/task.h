@@ -0,0 +1,99 @@
+/*****************************************************************************
+ *   task.h:  Header file for the stackless cooperative task scheduler
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __TASK_H
+#define __TASK_H
+
+#include "lpc_types.h"
+
+/*
+ * A task is a function that returns whenever it has to wait and carries
+ * on from the same place the next time it is run, the place is kept as a
+ * line number in the task_t. There is no stack per task, so:
+ *   - local variables are lost at every wait, keep state in statics
+ *   - the TASK_x macros must be used in the task function itself, not in
+ *     a function it calls
+ *   - no switch statement may enclose a wait
+ *
+ *   static int8_t blink (task_t *t)
+ *   {
+ *       TASK_BEGIN(t);
+ *       while (1) {
+ *           TASK_WAIT_EVENT(t, EV_BUTTON);
+ *           toggle();
+ *           TASK_SLEEP(t, 500);
+ *       }
+ *       TASK_END(t);
+ *   }
+ */
+
+#define TASK_WAITING 0
+#define TASK_ENDED   1
+
+typedef struct task
+{
+    uint16_t lc;            /* line to carry on from, 0 at the start */
+    uint8_t timed;          /* wakeAt is valid */
+    uint8_t ended;
+    uint32_t waitEvents;    /* EV_x bits to wait for, 0 for none */
+    uint32_t events;        /* bits of waitEvents that woke the task */
+    uint32_t wakeAt;        /* ms tick */
+    int8_t (*run)(struct task *t);
+    struct task *next;
+} task_t;
+
+/* Local continuations, a switch on the line number */
+#define TASK_BEGIN(t)   switch ((t)->lc) { case 0:
+#define TASK_END(t)     } (t)->lc = 0; return TASK_ENDED
+#define TASK_SET_LC(t)  (t)->lc = __LINE__; case __LINE__:
+
+/* Return and carry on here the next time the task is run */
+#define TASK_YIELD(t) \
+    do { \
+        (t)->lc = __LINE__; return TASK_WAITING; case __LINE__: ; \
+    } while (0)
+
+/* Wait until cond is true, it is checked every time the tasks are run */
+#define TASK_WAIT_UNTIL(t, cond) \
+    do { \
+        TASK_SET_LC(t); \
+        if (!(cond)) \
+            return TASK_WAITING; \
+    } while (0)
+
+/* Wait for any of the EV_x bits in mask, t->events holds the ones posted */
+#define TASK_WAIT_EVENT(t, mask) \
+    do { \
+        (t)->waitEvents = (mask); \
+        (t)->events = 0; \
+        TASK_SET_LC(t); \
+        if ((t)->events == 0) \
+            return TASK_WAITING; \
+        (t)->waitEvents = 0; \
+    } while (0)
+
+/* Wait for ms milliseconds, events posted meanwhile are not seen */
+#define TASK_SLEEP(t, ms) \
+    do { \
+        (t)->wakeAt = task_now() + (ms); \
+        (t)->timed = 1; \
+        TASK_SET_LC(t); \
+        if ((t)->timed) \
+            return TASK_WAITING; \
+    } while (0)
+
+
+void task_add (task_t *t, int8_t (*run)(task_t *t));
+void task_run (uint32_t events, uint32_t ms);
+int32_t task_nextWake (uint32_t *at);
+uint32_t task_now (void);
+
+
+#endif /* end __TASK_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
@@ -0,0 +1,286 @@
+/*****************************************************************************
+ *   telemetry.c:  Binary telemetry frames, COBS framed with a CRC16
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * A frame is 18 bytes on the wire, against about 45 for the text line
+ * and up to 100 when the warning messages are sent as well. COBS removes
+ * all 0x00 bytes from the payload so a receiver can resynchronise on the
+ * next 0x00 after losing bytes.
+ *
+ * The delta stream sends only what changed since the previous sample as
+ * small varints. A steady sample takes 6 bytes on the wire and a typical
+ * one with sensor noise about 11, with a full keyframe every
+ * keyInterval records to bound the loss after a bad record.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "telemetry.h"
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+/* CRC16-CCITT, one entry per nibble */
+static const uint16_t crcNibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+static void put16 (uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32 (uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/* Append v as a little endian base 128 varint, returns bytes written */
+static uint32_t putVarint (uint8_t *p, uint32_t v)
+{
+    uint32_t n = 0;
+
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+
+    return n;
+}
+
+/* Map small signed values to small unsigned ones: 0, -1, 1, -2 -> 0, 1, 2, 3 */
+static uint32_t zigzag (int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+/* CRC, COBS and delimiter around a payload, payload must have room for the CRC */
+static uint32_t frameRecord (uint8_t *payload, uint32_t len, uint8_t *frame)
+{
+    put16(&payload[len], telemetry_crc16(payload, len));
+    len = telemetry_cobsEncode(payload, len + 2, frame);
+    frame[len++] = 0x00;
+
+    return len;
+}
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Build the wire frame of one sample
+ *
+ * Params:
+ *   [in] sample - sample to send
+ *   [out] frame - buffer of at least TELEMETRY_FRAME_MAX bytes
+ *
+ * Returns:
+ *    Number of bytes in frame, including the 0x00 delimiter
+ *
+ *****************************************************************************/
+uint32_t telemetry_frame (const telemetry_sample_t *sample, uint8_t *frame)
+{
+    uint8_t raw[TELEMETRY_SAMPLE_LEN + 2];
+
+    put16(&raw[TELEMETRY_OFS_SEQ], sample->seq);
+    put32(&raw[TELEMETRY_OFS_TIME], sample->timestamp);
+    put16(&raw[TELEMETRY_OFS_TEMP], (uint16_t)sample->temperature);
+    put16(&raw[TELEMETRY_OFS_LIGHT],
+            (sample->light > 0xFFFF) ? 0xFFFF : (uint16_t)sample->light);
+    raw[TELEMETRY_OFS_ACC_X] = (uint8_t)sample->x;
+    raw[TELEMETRY_OFS_ACC_Y] = (uint8_t)sample->y;
+    raw[TELEMETRY_OFS_ACC_Z] = (uint8_t)sample->z;
+    raw[TELEMETRY_OFS_WARNINGS] = sample->warnings;
+
+    return frameRecord(raw, TELEMETRY_SAMPLE_LEN, frame);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    CRC16-CCITT (poly 0x1021, init 0xFFFF, no reflection)
+ *
+ *****************************************************************************/
+uint16_t telemetry_crc16 (const uint8_t *data, uint32_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    while (len--) {
+        crc = (crc << 4) ^ crcNibble[(crc >> 12) ^ (*data >> 4)];
+        crc = (crc << 4) ^ crcNibble[(crc >> 12) ^ (*data & 0x0F)];
+        data++;
+    }
+
+    return crc;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    COBS encode a block. The delimiter is not appended.
+ *
+ * Params:
+ *   [in] in - data to encode
+ *   [in] len - number of bytes in data
+ *   [out] out - buffer of at least TELEMETRY_COBS_MAX(len) bytes
+ *
+ * Returns:
+ *    Number of bytes written to out
+ *
+ *****************************************************************************/
+uint32_t telemetry_cobsEncode (const uint8_t *in, uint32_t len, uint8_t *out)
+{
+    uint32_t code = 0;  /* where the code byte of the current block goes */
+    uint32_t o = 1;
+    uint8_t run = 1;
+
+    while (len--) {
+        if (*in == 0) {
+            out[code] = run;
+            code = o++;
+            run = 1;
+        } else {
+            out[o++] = *in;
+            if (++run == 0xFF) {
+                out[code] = run;
+                code = o++;
+                run = 1;
+            }
+        }
+        in++;
+    }
+    out[code] = run;
+
+    return o;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Start a new compressed stream, the next record is a keyframe
+ *
+ * Params:
+ *   [out] enc - encoder state
+ *   [in] keyInterval - records from one keyframe to the next, at least 1
+ *
+ *****************************************************************************/
+void telemetry_deltaInit (telemetry_delta_t *enc, uint16_t keyInterval)
+{
+    enc->keyInterval = (keyInterval == 0) ? 1 : keyInterval;
+    enc->sinceKey = 0;
+    enc->prevInterval = 0;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Make the next record a keyframe, e.g. after the previous one could
+ *    not be sent. The receiver drops the deltas until then.
+ *
+ *****************************************************************************/
+void telemetry_deltaKey (telemetry_delta_t *enc)
+{
+    enc->sinceKey = 0;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Build the wire frame of the next record of a compressed stream
+ *
+ * Params:
+ *   [in/out] enc - encoder state
+ *   [in] sample - sample to send
+ *   [out] frame - buffer of at least TELEMETRY_DELTA_FRAME_MAX bytes
+ *
+ * Returns:
+ *    Number of bytes in frame, including the 0x00 delimiter
+ *
+ *****************************************************************************/
+uint32_t telemetry_deltaFrame (telemetry_delta_t *enc,
+        const telemetry_sample_t *sample, uint8_t *frame)
+{
+    const telemetry_sample_t *prev = &enc->prev;
+    uint8_t raw[TELEMETRY_DELTA_PAYLOAD_MAX + 2];
+    uint32_t len = 1;
+    uint32_t interval;
+    int32_t d;
+
+    if (enc->sinceKey == 0) {
+        raw[0] = TELEMETRY_DELTA_KEY;
+        len += putVarint(&raw[len], sample->seq);
+        len += putVarint(&raw[len], sample->timestamp);
+        len += putVarint(&raw[len], zigzag(sample->temperature));
+        len += putVarint(&raw[len], sample->light);
+        len += putVarint(&raw[len], zigzag(sample->x));
+        len += putVarint(&raw[len], zigzag(sample->y));
+        len += putVarint(&raw[len], zigzag(sample->z));
+        raw[len++] = sample->warnings;
+        interval = 0;
+    } else {
+        raw[0] = 0;
+
+        /* absolute, a receiver sees a missed record by it */
+        raw[len++] = (uint8_t)sample->seq;
+
+        interval = sample->timestamp - prev->timestamp;
+        d = (int32_t)(interval - enc->prevInterval);
+        if (d != 0) {
+            raw[0] |= TELEMETRY_DELTA_TIME;
+            len += putVarint(&raw[len], zigzag(d));
+        }
+
+        d = sample->temperature - prev->temperature;
+        if (d != 0) {
+            raw[0] |= TELEMETRY_DELTA_TEMP;
+            len += putVarint(&raw[len], zigzag(d));
+        }
+
+        d = (int32_t)(sample->light - prev->light);
+        if (d != 0) {
+            raw[0] |= TELEMETRY_DELTA_LIGHT;
+            len += putVarint(&raw[len], zigzag(d));
+        }
+
+        if (sample->x != prev->x || sample->y != prev->y
+                || sample->z != prev->z) {
+            raw[0] |= TELEMETRY_DELTA_ACC;
+            len += putVarint(&raw[len], zigzag(sample->x - prev->x));
+            len += putVarint(&raw[len], zigzag(sample->y - prev->y));
+            len += putVarint(&raw[len], zigzag(sample->z - prev->z));
+        }
+
+        if (sample->warnings != prev->warnings) {
+            raw[0] |= TELEMETRY_DELTA_WARN;
+            raw[len++] = sample->warnings;
+        }
+    }
+
+    enc->prev = *sample;
+    enc->prevInterval = interval;
+    if (++enc->sinceKey >= enc->keyInterval)
+        enc->sinceKey = 0;
+
+    return frameRecord(raw, len, frame);
+}
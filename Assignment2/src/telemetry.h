@@ -0,0 +1,106 @@
+/*****************************************************************************
+ *   telemetry.h:  Header file for the binary telemetry frames
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+#include "lpc_types.h"
+
+/*
+ * Sample layout before framing, multi-byte values are little endian.
+ * A CRC16-CCITT (poly 0x1021, init 0xFFFF) over the sample follows it,
+ * then the whole is COBS encoded and terminated by a 0x00 byte.
+ * tools/telemetry_decode.c turns a captured stream back into CSV.
+ */
+#define TELEMETRY_OFS_SEQ       0   /* uint16, wraps */
+#define TELEMETRY_OFS_TIME      2   /* uint32, ms since reset */
+#define TELEMETRY_OFS_TEMP      6   /* int16, 10 x T(C) */
+#define TELEMETRY_OFS_LIGHT     8   /* uint16, lux, saturates */
+#define TELEMETRY_OFS_ACC_X     10  /* int8 */
+#define TELEMETRY_OFS_ACC_Y     11  /* int8 */
+#define TELEMETRY_OFS_ACC_Z     12  /* int8 */
+#define TELEMETRY_OFS_WARNINGS  13  /* TELEMETRY_WARN_x bits */
+#define TELEMETRY_SAMPLE_LEN    14
+
+#define TELEMETRY_WARN_HIGH_TEMP 0x01
+#define TELEMETRY_WARN_MOVEMENT  0x02
+
+/* Worst case COBS output for n bytes, without the delimiter */
+#define TELEMETRY_COBS_MAX(n)   ((n) + (n) / 254 + 1)
+
+/* Sample, CRC, COBS overhead and delimiter */
+#define TELEMETRY_FRAME_MAX     (TELEMETRY_COBS_MAX(TELEMETRY_SAMPLE_LEN + 2) + 1)
+
+/*
+ * Compressed stream. Every record is framed like a sample above
+ * (CRC16, COBS, 0x00) but its payload starts with a header byte:
+ *
+ * Keyframe, header TELEMETRY_DELTA_KEY: seq, timestamp, temp, light, x,
+ * y, z as varints followed by the warnings byte. Signed values are
+ * zigzag encoded.
+ *
+ * Delta, header with TELEMETRY_DELTA_KEY clear: the low byte of seq,
+ * then only the fields whose bit is set, in this order, as zigzag
+ * varints of
+ *   TIME  - interval - previous interval (0 after a keyframe)
+ *   TEMP  - temp - previous temp
+ *   LIGHT - light - previous light
+ *   ACC   - x, y and z - previous x, y and z
+ *   WARN  - new warnings byte, not a delta
+ *
+ * A keyframe is sent every keyInterval records, and after a record the
+ * sender could not send. Every delta depends on the record before it, a
+ * receiver that misses or rejects one drops deltas until the next
+ * keyframe. A missed record shows as a jump of the seq byte.
+ */
+#define TELEMETRY_DELTA_KEY     0x80
+#define TELEMETRY_DELTA_TIME    0x02
+#define TELEMETRY_DELTA_TEMP    0x04
+#define TELEMETRY_DELTA_LIGHT   0x08
+#define TELEMETRY_DELTA_ACC     0x10
+#define TELEMETRY_DELTA_WARN    0x20
+
+/* Largest record payload: header, 4 varints of up to 5 bytes, 3 of 2, warnings */
+#define TELEMETRY_DELTA_PAYLOAD_MAX 28
+
+#define TELEMETRY_DELTA_FRAME_MAX \
+    (TELEMETRY_COBS_MAX(TELEMETRY_DELTA_PAYLOAD_MAX + 2) + 1)
+
+typedef struct
+{
+    uint16_t seq;
+    uint32_t timestamp;
+    int16_t temperature;
+    uint32_t light;
+    int8_t x;
+    int8_t y;
+    int8_t z;
+    uint8_t warnings;
+} telemetry_sample_t;
+
+typedef struct
+{
+    telemetry_sample_t prev;
+    uint32_t prevInterval;
+    uint16_t keyInterval;
+    uint16_t sinceKey;
+} telemetry_delta_t;
+
+
+uint32_t telemetry_frame (const telemetry_sample_t *sample, uint8_t *frame);
+uint16_t telemetry_crc16 (const uint8_t *data, uint32_t len);
+uint32_t telemetry_cobsEncode (const uint8_t *in, uint32_t len, uint8_t *out);
+void telemetry_deltaInit (telemetry_delta_t *enc, uint16_t keyInterval);
+void telemetry_deltaKey (telemetry_delta_t *enc);
+uint32_t telemetry_deltaFrame (telemetry_delta_t *enc,
+        const telemetry_sample_t *sample, uint8_t *frame);
+
+
+#endif /* end __TELEMETRY_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
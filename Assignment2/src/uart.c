@@ -0,0 +1,359 @@
+/*****************************************************************************
+ *   uart.c:  Interrupt driven transmit and receive buffers for the UART3
+ *            terminal
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * NOTE: UART3 must have been initialized (UART_Init) before calling
+ * uart_init().
+ *
+ * uart_write() only copies into a ring buffer and returns. The ring is
+ * drained into the 16 byte TX FIFO from the THRE interrupt, which is
+ * routed through UART3_StdIntHandler to txHandler().
+ *
+ * Received bytes are moved from the RX FIFO into a second ring buffer by
+ * rxHandler() on the RDA and character time-out interrupts, and are
+ * picked up with uart_read() from the main loop.
+ *
+ * uart_beginTxDma() hands the transmitter to the GPDMA (see uartdma.c)
+ * once the ring has drained. uart_write() keeps queueing meanwhile, and
+ * uart_endTxDma() sends what was queued once the DMA is done.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "lpc17xx_uart.h"
+#include "uart.h"
+
+/******************************************************************************
+ * Defines and typedefs
+ *****************************************************************************/
+
+#define UARTDEV LPC_UART3
+
+#define TX_MASK (UART_TX_BUF_SIZE - 1)
+#define RX_MASK (UART_RX_BUF_SIZE - 1)
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+static uint8_t txBuf[UART_TX_BUF_SIZE];
+
+/* head is only written by uart_write, tail only by the interrupt */
+static volatile uint32_t txHead = 0;
+static volatile uint32_t txTail = 0;
+
+/* Set while the THRE interrupt is expected to keep draining the ring */
+static volatile uint8_t txRunning = 0;
+
+/* Set while the GPDMA owns the transmitter */
+static volatile uint8_t txDma = 0;
+
+static volatile uint32_t dropCount = 0;
+
+static uint8_t rxBuf[UART_RX_BUF_SIZE];
+
+/* head is only written by the interrupt, tail only by uart_read */
+static volatile uint32_t rxHead = 0;
+static volatile uint32_t rxTail = 0;
+
+static volatile uint32_t rxOverflowCount = 0;
+
+/* Called in interrupt context when bytes were received, may be NULL */
+static void (*onRx)(void) = NULL;
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+/* RX interrupt every 8 bytes, the time-out picks up the rest */
+static void configFifo(FunctionalState dmaMode, FunctionalState reset)
+{
+    UART_FIFO_CFG_Type fifoCfg;
+
+    fifoCfg.FIFO_DMAMode = dmaMode;
+    fifoCfg.FIFO_Level = UART_FIFO_TRGLEV2;
+    fifoCfg.FIFO_ResetRxBuf = reset;
+    fifoCfg.FIFO_ResetTxBuf = reset;
+    UART_FIFOConfig(UARTDEV, &fifoCfg);
+}
+
+/* Move up to one FIFO worth of bytes from the ring to the UART */
+static void fillFifo(void)
+{
+    uint32_t n = UART_TX_FIFO_SIZE;
+    uint32_t tail = txTail;
+
+    while (n && tail != txHead) {
+        UARTDEV->THR = txBuf[tail];
+        tail = (tail + 1) & TX_MASK;
+        n--;
+    }
+    txTail = tail;
+
+    /* nothing was written, no THRE interrupt will follow */
+    txRunning = (n != UART_TX_FIFO_SIZE);
+}
+
+/* THRE call-back, runs in interrupt context */
+static void txHandler(void)
+{
+    fillFifo();
+}
+
+/* RDA and CTI call-back, runs in interrupt context */
+static void rxHandler(void)
+{
+    uint32_t head = rxHead;
+    uint8_t c;
+
+    while (UARTDEV->LSR & UART_LSR_RDR) {
+        c = UARTDEV->RBR;
+        if (((head + 1) & RX_MASK) == rxTail) {
+            rxOverflowCount++;
+            continue;
+        }
+        rxBuf[head] = c;
+        head = (head + 1) & RX_MASK;
+    }
+
+    if (head != rxHead) {
+        rxHead = head;
+        if (onRx != NULL)
+            onRx();
+    }
+}
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Enable the FIFOs and the transmit and receive interrupts of UART3
+ *
+ *****************************************************************************/
+void uart_init (void)
+{
+    configFifo(DISABLE, ENABLE);
+
+    UART_SetupCbs(UARTDEV, 0, (void *)rxHandler);
+    UART_SetupCbs(UARTDEV, 1, (void *)txHandler);
+    UART_IntConfig(UARTDEV, UART_INTCFG_RBR, ENABLE);
+    UART_IntConfig(UARTDEV, UART_INTCFG_THRE, ENABLE);
+
+    NVIC_ClearPendingIRQ(UART3_IRQn);
+    NVIC_EnableIRQ(UART3_IRQn);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Queue data for transmission. Never blocks.
+ *
+ * Params:
+ *   [in] buf - data to send
+ *   [in] len - number of bytes
+ *
+ * Returns:
+ *    len if the data was queued, 0 if it did not fit. Data that does not
+ *    fit is dropped as a whole, so lines are never cut in half, and the
+ *    number of dropped bytes is added to the drop counter.
+ *
+ *****************************************************************************/
+uint32_t uart_write (const uint8_t *buf, uint32_t len)
+{
+    uint32_t head = txHead;
+    uint32_t space = (txTail - head - 1) & TX_MASK;
+    uint32_t i;
+
+    if (len > space) {
+        dropCount += len;
+        return 0;
+    }
+
+    for (i = 0; i < len; i++) {
+        txBuf[head] = buf[i];
+        head = (head + 1) & TX_MASK;
+    }
+    txHead = head;
+
+    /* transmitter is idle, the first bytes have to be pushed by hand */
+    NVIC_DisableIRQ(UART3_IRQn);
+    if (!txRunning && !txDma)
+        fillFifo();
+    NVIC_EnableIRQ(UART3_IRQn);
+
+    return len;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Queue a null-terminated string, see uart_write
+ *
+ *****************************************************************************/
+uint32_t uart_writeString (const char *str)
+{
+    uint32_t len = 0;
+
+    while (str[len] != '\0')
+        len++;
+
+    return uart_write((const uint8_t *)str, len);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Number of bytes dropped because the transmit buffer was full
+ *
+ *****************************************************************************/
+uint32_t uart_getDropCount (void)
+{
+    return dropCount;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Change the baud rate once everything queued so far has been sent.
+ *    Blocks until the transmit buffer is empty.
+ *
+ * Params:
+ *   [in] baudrate - new rate
+ *
+ * Returns:
+ *    SUCCESS, or ERROR if the rate cannot be reached (old rate is kept)
+ *
+ *****************************************************************************/
+Status uart_setBaudrate (uint32_t baudrate)
+{
+    Status status;
+
+    while (txRunning)
+        ;
+
+    /* DLL/DLM overlay THR/IER while they are written */
+    NVIC_DisableIRQ(UART3_IRQn);
+    status = UART_SetBaudrate(UARTDEV, baudrate);
+    NVIC_EnableIRQ(UART3_IRQn);
+
+    return status;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Hand the transmitter to the GPDMA. Blocks until the transmit buffer is
+ *    empty, then stops the THRE interrupt and puts the FIFO in DMA mode
+ *    without flushing the receiver. uartdma can send on UART3 afterwards.
+ *
+ *****************************************************************************/
+void uart_beginTxDma (void)
+{
+    while (1) {
+        NVIC_DisableIRQ(UART3_IRQn);
+        if (!txRunning)
+            break;
+        NVIC_EnableIRQ(UART3_IRQn);
+    }
+
+    txDma = 1;
+    UART_IntConfig(UARTDEV, UART_INTCFG_THRE, DISABLE);
+    configFifo(ENABLE, DISABLE);
+    NVIC_EnableIRQ(UART3_IRQn);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Take the transmitter back from the GPDMA and send what uart_write
+ *    queued meanwhile. Call it once the DMA transfer is done, it blocks
+ *    until the last DMA bytes have left the FIFO.
+ *
+ *****************************************************************************/
+void uart_endTxDma (void)
+{
+    while (!(UARTDEV->LSR & UART_LSR_THRE))
+        ;
+
+    NVIC_DisableIRQ(UART3_IRQn);
+    configFifo(DISABLE, DISABLE);
+    UART_IntConfig(UARTDEV, UART_INTCFG_THRE, ENABLE);
+    txDma = 0;
+    fillFifo();
+    NVIC_EnableIRQ(UART3_IRQn);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Take received bytes out of the receive buffer. Never blocks.
+ *
+ * Params:
+ *   [out] buf - destination
+ *   [in] len - size of buf
+ *
+ * Returns:
+ *    Number of bytes copied to buf, 0 if nothing was received
+ *
+ *****************************************************************************/
+uint32_t uart_read (uint8_t *buf, uint32_t len)
+{
+    uint32_t tail = rxTail;
+    uint32_t n = 0;
+
+    while (n < len && tail != rxHead) {
+        buf[n++] = rxBuf[tail];
+        tail = (tail + 1) & RX_MASK;
+    }
+    rxTail = tail;
+
+    return n;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Set a function to call when bytes were received, e.g. to wake the
+ *    main loop. It runs in interrupt context, uart_read() takes the bytes.
+ *
+ * Params:
+ *   [in] handler - the function, NULL for none
+ *
+ *****************************************************************************/
+void uart_setRxHandler (void (*handler)(void))
+{
+    onRx = handler;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Number of received bytes lost because the receive buffer was full
+ *
+ *****************************************************************************/
+uint32_t uart_getRxOverflowCount (void)
+{
+    return rxOverflowCount;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    UART3 interrupt, dispatched by the UART driver to the call-backs
+ *
+ *****************************************************************************/
+void UART3_IRQHandler (void)
+{
+    UART3_StdIntHandler();
+}
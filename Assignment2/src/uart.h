@@ -0,0 +1,35 @@
+/*****************************************************************************
+ *   uart.h:  Header file for the buffered UART3 terminal
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __UART_H
+#define __UART_H
+
+#include "lpc_types.h"
+
+/* Size of the transmit ring buffer, must be a power of two */
+#define UART_TX_BUF_SIZE 512
+
+/* Size of the receive ring buffer, must be a power of two */
+#define UART_RX_BUF_SIZE 64
+
+
+void uart_init (void);
+uint32_t uart_write (const uint8_t *buf, uint32_t len);
+uint32_t uart_writeString (const char *str);
+uint32_t uart_getDropCount (void);
+uint32_t uart_read (uint8_t *buf, uint32_t len);
+uint32_t uart_getRxOverflowCount (void);
+void uart_setRxHandler (void (*handler)(void));
+Status uart_setBaudrate (uint32_t baudrate);
+void uart_beginTxDma (void);
+void uart_endTxDma (void);
+
+
+#endif /* end __UART_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
@@ -0,0 +1,259 @@
+/*****************************************************************************
+ *   uartdma.c:  DMA driven transmit for UART0..3
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * NOTE: the UART must have been initialized (UART_Init) and its FIFO put
+ * in DMA mode before sending, the TX DMA request is only driven then. For
+ * UART3 uart_beginTxDma() does that and takes the transmitter from the
+ * interrupt driven ring, uart_endTxDma() gives it back.
+ *
+ * A transfer is split into linked list items of at most
+ * UARTDMA_MAX_ITEM_LEN bytes which the GPDMA follows on its own. Only the
+ * last item raises the terminal count interrupt, so the CPU is involved
+ * once per transfer regardless of its length. The data must stay valid
+ * until the done call-back has run.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "lpc17xx_gpdma.h"
+#include "lpc17xx_uart.h"
+#include "dma.h"
+#include "uartdma.h"
+
+/******************************************************************************
+ * Defines and typedefs
+ *****************************************************************************/
+
+#define ITEM_CONTROL(len) \
+    (GPDMA_DMACCxControl_TransferSize(len) \
+    | GPDMA_DMACCxControl_SBSize(GPDMA_BSIZE_1) \
+    | GPDMA_DMACCxControl_DBSize(GPDMA_BSIZE_1) \
+    | GPDMA_DMACCxControl_SWidth(GPDMA_WIDTH_BYTE) \
+    | GPDMA_DMACCxControl_DWidth(GPDMA_WIDTH_BYTE) \
+    | GPDMA_DMACCxControl_SI)
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+static LPC_UART_TypeDef * const uarts[UARTDMA_NUM_PORTS] = {
+    (LPC_UART_TypeDef *)LPC_UART0,
+    (LPC_UART_TypeDef *)LPC_UART1,
+    LPC_UART2,
+    LPC_UART3
+};
+
+static const uint32_t conns[UARTDMA_NUM_PORTS] = {
+    GPDMA_CONN_UART0_Tx,
+    GPDMA_CONN_UART1_Tx,
+    GPDMA_CONN_UART2_Tx,
+    GPDMA_CONN_UART3_Tx
+};
+
+/* Must follow UARTDMA_CHANNEL_BASE */
+static LPC_GPDMACH_TypeDef * const channels[UARTDMA_NUM_PORTS] = {
+    LPC_GPDMACH4,
+    LPC_GPDMACH5,
+    LPC_GPDMACH6,
+    LPC_GPDMACH7
+};
+
+/* The GPDMA reads items straight from RAM, addresses must be word aligned */
+static GPDMA_LLI_Type items[UARTDMA_NUM_PORTS][UARTDMA_MAX_ITEMS]
+    __attribute__ ((aligned (4)));
+
+static uartdma_done_t doneCb[UARTDMA_NUM_PORTS];
+static volatile uint8_t busy[UARTDMA_NUM_PORTS];
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+static void transferDone(uint8_t port, uint32_t dmaStatus)
+{
+    uartdma_done_t cb = doneCb[port];
+
+    if (dmaStatus == GPDMA_STAT_INTERR)
+        GPDMA_ChannelCmd(UARTDMA_CHANNEL_BASE + port, DISABLE);
+
+    busy[port] = 0;
+
+    if (cb != NULL)
+        cb(port, (dmaStatus == GPDMA_STAT_INTTC) ? 0 : -1);
+}
+
+/* The GPDMA call-back does not tell the channel, one per port */
+static void dmaDone0(uint32_t status) { transferDone(0, status); }
+static void dmaDone1(uint32_t status) { transferDone(1, status); }
+static void dmaDone2(uint32_t status) { transferDone(2, status); }
+static void dmaDone3(uint32_t status) { transferDone(3, status); }
+
+static fnGPDMACbs_Type * const dmaCbs[UARTDMA_NUM_PORTS] = {
+    dmaDone0,
+    dmaDone1,
+    dmaDone2,
+    dmaDone3
+};
+
+/*
+ * Turn the buffer chain into linked list items, splitting buffers longer
+ * than UARTDMA_MAX_ITEM_LEN. Returns the number of items or -1 if the chain
+ * needs more than UARTDMA_MAX_ITEMS.
+ */
+static int32_t buildItems(uint8_t port, const uartdma_buf_t *chain)
+{
+    GPDMA_LLI_Type *lli = items[port];
+    uint32_t dst = (uint32_t)&uarts[port]->THR;
+    int32_t n = 0;
+
+    for (; chain != NULL; chain = chain->next) {
+        const uint8_t *p = chain->data;
+        uint32_t left = chain->len;
+
+        while (left > 0) {
+            uint32_t len = (left > UARTDMA_MAX_ITEM_LEN) ?
+                    UARTDMA_MAX_ITEM_LEN : left;
+
+            if (n >= UARTDMA_MAX_ITEMS)
+                return -1;
+
+            lli[n].SrcAddr = (uint32_t)p;
+            lli[n].DstAddr = dst;
+            lli[n].NextLLI = 0;
+            lli[n].Control = ITEM_CONTROL(len);
+            if (n > 0)
+                lli[n-1].NextLLI = (uint32_t)&lli[n];
+
+            p += len;
+            left -= len;
+            n++;
+        }
+    }
+
+    if (n > 0)
+        lli[n-1].Control |= GPDMA_DMACCxControl_I;
+
+    return n;
+}
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+/******************************************************************************
+ *
+ * Description:
+ *    Prepare a port for DMA transmit. The GPDMA controller is powered up
+ *    if no other module did it yet. The FIFO is left as it is, see the
+ *    note at the top.
+ *
+ * Params:
+ *   [in] port - UART number, 0..3
+ *
+ *****************************************************************************/
+void uartdma_init (uint8_t port)
+{
+    if (port >= UARTDMA_NUM_PORTS)
+        return;
+
+    dma_init();
+
+    busy[port] = 0;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Start sending one buffer, see uartdma_sendChain
+ *
+ *****************************************************************************/
+int32_t uartdma_send (uint8_t port, const uint8_t *buf, uint32_t len,
+        uartdma_done_t done)
+{
+    uartdma_buf_t one;
+
+    one.data = buf;
+    one.len = len;
+    one.next = NULL;
+
+    /* the chain is only read while building the items */
+    return uartdma_sendChain(port, &one, done);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Start sending a chain of buffers. Returns immediately, done is called
+ *    from the DMA interrupt once the last byte has been written to the
+ *    UART FIFO.
+ *
+ * Params:
+ *   [in] port - UART number, 0..3
+ *   [in] chain - first buffer of the chain
+ *   [in] done - completion call-back, may be NULL
+ *
+ * Returns:
+ *    0 if the transfer was started, -1 if the port is busy, the chain is
+ *    empty or needs more than UARTDMA_MAX_ITEMS items
+ *
+ *****************************************************************************/
+int32_t uartdma_sendChain (uint8_t port, const uartdma_buf_t *chain,
+        uartdma_done_t done)
+{
+    GPDMA_Channel_CFG_Type cfg;
+    GPDMA_LLI_Type *first;
+    int32_t n;
+
+    if (port >= UARTDMA_NUM_PORTS || busy[port])
+        return -1;
+
+    n = buildItems(port, chain);
+    if (n <= 0)
+        return -1;
+
+    first = &items[port][0];
+
+    cfg.ChannelNum = UARTDMA_CHANNEL_BASE + port;
+    cfg.TransferSize = GPDMA_DMACCxControl_TransferSize(first->Control);
+    cfg.TransferWidth = 0;
+    cfg.SrcMemAddr = first->SrcAddr;
+    cfg.DstMemAddr = 0;
+    cfg.TransferType = GPDMA_TRANSFERTYPE_M2P;
+    cfg.SrcConn = 0;
+    cfg.DstConn = conns[port];
+    cfg.DMALLI = first->NextLLI;
+
+    if (GPDMA_Setup(&cfg, dmaCbs[port]) != SUCCESS)
+        return -1;
+
+    /* only the last item may raise the terminal count interrupt */
+    channels[port]->DMACCControl = first->Control;
+
+    doneCb[port] = done;
+    busy[port] = 1;
+    GPDMA_ChannelCmd(UARTDMA_CHANNEL_BASE + port, ENABLE);
+
+    return 0;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Check if a transfer is still running on a port
+ *
+ *****************************************************************************/
+uint8_t uartdma_isBusy (uint8_t port)
+{
+    if (port >= UARTDMA_NUM_PORTS)
+        return 0;
+
+    return busy[port];
+}
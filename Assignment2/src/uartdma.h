@@ -0,0 +1,49 @@
+/*****************************************************************************
+ *   uartdma.h:  Header file for DMA driven UART transmit
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+******************************************************************************/
+#ifndef __UARTDMA_H
+#define __UARTDMA_H
+
+#include "lpc_types.h"
+
+/* Number of UARTs, port n uses UARTn */
+#define UARTDMA_NUM_PORTS 4
+
+/* Port n transmits on GPDMA channel UARTDMA_CHANNEL_BASE + n */
+#define UARTDMA_CHANNEL_BASE 4
+
+/* Largest number of bytes one linked list item can move */
+#define UARTDMA_MAX_ITEM_LEN 4095
+
+/* Linked list items per port, limits the length of one transfer */
+#ifndef UARTDMA_MAX_ITEMS
+#define UARTDMA_MAX_ITEMS 16
+#endif
+
+typedef struct uartdma_buf_s
+{
+    const uint8_t *data;
+    uint32_t len;
+    const struct uartdma_buf_s *next;   /* NULL terminates the chain */
+} uartdma_buf_t;
+
+/* status is 0 when all data was sent, -1 on a bus error */
+typedef void (*uartdma_done_t)(uint8_t port, int32_t status);
+
+
+void uartdma_init (uint8_t port);
+int32_t uartdma_send (uint8_t port, const uint8_t *buf, uint32_t len,
+        uartdma_done_t done);
+int32_t uartdma_sendChain (uint8_t port, const uartdma_buf_t *chain,
+        uartdma_done_t done);
+uint8_t uartdma_isBusy (uint8_t port);
+
+
+#endif /* end __UARTDMA_H */
+/****************************************************************************
+**                            End Of File
+*****************************************************************************/
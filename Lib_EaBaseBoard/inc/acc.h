@@ -24,13 +24,51 @@ typedef enum
     ACC_RANGE_4G,
 } acc_range_t;
 
+/*
+ * One output of the sensor. pad keeps a sample at 4 bytes so it can be
+ * handled as a single word.
+ */
+typedef struct
+{
+    int8_t x;
+    int8_t y;
+    int8_t z;
+    int8_t pad;
+} acc_sample_t;
+
+/* The 10 bit outputs are 64 counts per g at any range */
+#define ACC_10BIT_LSB_PER_G 64
+#define ACC_10BIT_TO_MG(c)  (((int32_t)(c) * 125) / 8)
+
+/* Movement reported by acc_getMotion() */
+#define ACC_MOTION_LEVEL 0x01
+#define ACC_MOTION_PULSE 0x02
+
+/* Samples held between two drains, about 2 s at 125 Hz. A power of 2 */
+#define ACC_RING_SIZE 256
+
 
 void acc_init (void);
 
-void acc_read (int8_t *x, int8_t *y, int8_t *z);
+int32_t acc_read (int8_t *x, int8_t *y, int8_t *z);
+int32_t acc_read10 (int16_t *x, int16_t *y, int16_t *z);
 void acc_setRange(acc_range_t range);
 void acc_setMode(acc_mode_t mode);
 
+void acc_startSampling(void);
+void acc_stopSampling(void);
+void acc_drdy(void);
+uint32_t acc_getSamples(acc_sample_t *buf, uint32_t max);
+uint32_t acc_getOverflowCount(void);
+uint32_t acc_takePeak(void);
+
+void acc_startMotionDetect(uint32_t threshold, const acc_sample_t *restPos);
+void acc_stopMotionDetect(void);
+void acc_motionEvent(void);
+int32_t acc_motionPending(void);
+uint8_t acc_getMotion(void);
+int32_t acc_readLatest (int8_t *x, int8_t *y, int8_t *z);
+
 
 
 #endif /* end __LIGHT_H */
@@ -47,6 +47,8 @@ uint32_t light_read(void);
 void light_setMode(light_mode_t mode);
 void light_setWidth(light_width_t width);
 void light_setRange(light_range_t newRange);
+void light_setAutoRange(Bool enable);
+light_range_t light_getRange(void);
 void light_setHiThreshold(uint32_t luxTh);
 void light_setLoThreshold(uint32_t luxTh);
 void light_setIrqInCycles(light_cycle_t cycles);
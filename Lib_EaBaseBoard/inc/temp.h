@@ -8,9 +8,35 @@
 #ifndef __TEMP_H
 #define __TEMP_H
 
+/*
+ * Count the sensor periods on CAP3.0 (P0.23) with TIMER3, one interrupt
+ * per reading, instead of one EINT3 interrupt per falling edge of the
+ * GPIO input. Both are timed with the RIT at CCLK/4. Neither P0.2 nor
+ * P0.6 has a capture function, so the sensor output must be wired to
+ * P0.23. P0.23 is also AD0.0, the trimpot, which can then not be sampled.
+ */
+//#define TEMP_USE_CAP3_0
+
+/* Conversion speed, fewer sensor periods per reading are faster and coarser */
+typedef enum {
+    TEMP_PROFILE_FAST,
+    TEMP_PROFILE_NORMAL,
+    TEMP_PROFILE_PRECISE,
+    TEMP_PROFILE_AUTO       /* chosen from the last reading */
+} temp_profile_t;
+
+#define TEMP_NUM_PROFILES 3
 
 void temp_init (uint32_t (*getMsTick)(void));
 int32_t temp_read(void);
+void temp_start (void);
+void temp_stop (void);
+uint32_t temp_poll (int32_t *value);
+void temp_setReadyHandler (void (*handler)(void));
+void temp_edge (void);
+void temp_setProfile (temp_profile_t profile);
+temp_profile_t temp_getProfile (void);
+void temp_setAlarmLevel (int32_t level, int32_t band);
 
 
 #endif /* end __TEMP_H */
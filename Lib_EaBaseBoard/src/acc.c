@@ -9,6 +9,27 @@
 /*
  * NOTE: I2C must have been initialized before calling any functions in this
  * file.
+ *
+ * Sampling: with acc_startSampling() the sensor's DRDY output (INT1) is
+ * taken as a GPIO interrupt and every new output is read into a ring of
+ * ACC_RING_SIZE samples, at the output data rate of 125 Hz. The consumer
+ * drains it in batches with acc_getSamples(). acc_read() must not be used
+ * while sampling, it would steal samples from the ring.
+ *
+ * Resolution: the 8 bit outputs follow the g-range set with
+ * acc_setRange(), 64, 32 or 16 counts per g for 2g, 4g and 8g. The 10
+ * bit outputs are always 64 counts per g over the full 8g, so they have
+ * the step of the 2g range with the headroom of the 8g range. The ring
+ * and acc_readLatest() take the 10 bit outputs, saturated to 8 bits, so
+ * their unit is 1/64 g at every range but they clip at 2g. What goes
+ * past that is kept by acc_takePeak(), the largest 10 bit output on any
+ * axis, for shocks up to 8g.
+ *
+ * Motion detection: acc_startMotionDetect() hands the movement check to
+ * the sensor. Level detection is output on INT1 and pulse detection on
+ * INT2, both are latched by the sensor until cleared. The offset
+ * registers take out the rest position, so the thresholds apply to the
+ * change from it. Nothing is read until one of them fires.
  */
 
 /******************************************************************************
@@ -16,6 +37,8 @@
  *******************************************************8**********************/
 
 #include "lpc17xx_i2c.h"
+#include "lpc17xx_gpio.h"
+#include "lpc17xx_pinsel.h"
 #include "acc.h"
 
 /******************************************************************************
@@ -28,7 +51,7 @@
 #define ACC_ADDR_XOUTL  0x00
 #define ACC_ADDR_XOUTH  0x01
 #define ACC_ADDR_YOUTL  0x02
-#define ACC_ADDR_YOUTX  0x03
+#define ACC_ADDR_YOUTH  0x03
 #define ACC_ADDR_ZOUTL  0x04
 #define ACC_ADDR_ZOUTH  0x05
 #define ACC_ADDR_XOUT8  0x06
@@ -58,12 +81,54 @@
 
 #define ACC_MCTL_MODE(m) ((m) << 0)
 #define ACC_MCTL_GLVL(g) ((g) << 2)
+#define ACC_MCTL_DRPD    (1 << 6)   /* set: DRDY is not output on INT1 */
+
+#define ACC_CTL1_INTPIN    (1 << 0) /* set: INT1 and INT2 swapped */
+#define ACC_CTL1_INTREG(r) ((r) << 1) /* 0: level on INT1, pulse on INT2 */
+#define ACC_CTL1_THOPT     (1 << 6) /* set: signed thresholds */
+
+#define ACC_INTRST_CLR_INT1 0x01
+#define ACC_INTRST_CLR_INT2 0x02
+
+/* Level and pulse thresholds count 1/16 g (8g range) */
+#define ACC_THRESHOLD_LSB_UG 62500
+#define ACC_THRESHOLD_MAX    127
+
+/* Longest pulse still counted as one, in 0.5 ms: 30 ms */
+#define ACC_PULSE_WIDTH 60
+
 
+/* 10 bit outputs, two's complement in XOUTL and bits 1:0 of XOUTH */
+#define ACC_10BIT(l, h) ((int16_t)(((uint16_t)((h) & 0x03) << 14) \
+                        | ((uint16_t)(l) << 6)) >> 6)
 
 #define ACC_STATUS_DRDY 0x01
 #define ACC_STATUS_DOVR 0x02
 #define ACC_STATUS_PERR 0x04
 
+/*
+ * Number of status polls before giving up on the data ready flag. At
+ * 100 kHz one poll takes about 0.3 ms, the slowest output data rate is
+ * 125 Hz (8 ms), so this leaves plenty of margin.
+ */
+#define ACC_DRDY_MAX_POLLS 64
+
+/*
+ * INT1 of the MMA7455 is expected on P2.6. It is not routed to the MCU
+ * on the base board and needs a wire, change this if it goes elsewhere
+ * on port 2. The pins are pulled down, so without the wire they read
+ * low and nothing is ever read or detected.
+ */
+#define ACC_INT1_PORT 2
+#define ACC_INT1_NUM  6
+#define ACC_INT1_PIN  (1 << ACC_INT1_NUM)
+
+#define ACC_INT1_STATE ((GPIO_ReadValue(ACC_INT1_PORT) & ACC_INT1_PIN) != 0)
+
+/* INT2 is expected on P2.11, on the same port as INT1 */
+#define ACC_INT2_NUM  11
+#define ACC_INT2_PIN  (1 << ACC_INT2_NUM)
+
 
 /******************************************************************************
  * External global variables
@@ -73,23 +138,27 @@
  * Local variables
  *****************************************************************************/
 
-static int I2CRead(uint8_t addr, uint8_t* buf, uint32_t len)
-{
-	I2C_M_SETUP_Type rxsetup;
+/* Written only by acc_drdy(), read only by acc_getSamples() */
+static acc_sample_t ring[ACC_RING_SIZE];
+static volatile uint32_t ringHead = 0;
+static volatile uint32_t ringTail = 0;
+static volatile uint32_t ringOverflows = 0;
 
-	rxsetup.sl_addr7bit = addr;
-	rxsetup.tx_data = NULL;	// Get address to read at writing address
-	rxsetup.tx_length = 0;
-	rxsetup.rx_data = buf;
-	rxsetup.rx_length = len;
-	rxsetup.retransmissions_max = 3;
+static volatile uint8_t sampling = 0;
+static volatile uint8_t reading = 0;
 
-	if (I2C_MasterTransferData(I2CDEV, &rxsetup, I2C_TRANSFER_POLLING) == SUCCESS){
-		return (0);
-	} else {
-		return (-1);
-	}
-}
+/* A data ready whose read was deferred because I2C2 was busy */
+static volatile uint8_t drdyPending = 0;
+
+/* ACC_MOTION_x bits latched since the last acc_getMotion() */
+static volatile uint8_t motion = 0;
+static volatile uint8_t detecting = 0;
+
+/* Largest 10 bit output on any axis since the last acc_takePeak() */
+static volatile int16_t peak = 0;
+
+/* Rest position taken out by the offset registers while detecting */
+static acc_sample_t rest = {0, 0, 0, 0};
 
 static int I2CWrite(uint8_t addr, uint8_t* buf, uint32_t len)
 {
@@ -110,26 +179,46 @@ static int I2CWrite(uint8_t addr, uint8_t* buf, uint32_t len)
 }
 
 
+/*
+ * The register address and the read in one transfer, with a repeated
+ * start. The bus stays busy in between, so a read from interrupt context
+ * cannot move the register pointer.
+ */
+static int readReg(uint8_t reg, uint8_t* val)
+{
+    I2C_M_SETUP_Type setup;
+
+    setup.sl_addr7bit = ACC_I2C_ADDR;
+    setup.tx_data = &reg;
+    setup.tx_length = 1;
+    setup.rx_data = val;
+    setup.rx_length = 1;
+    setup.retransmissions_max = 3;
+
+    if (I2C_MasterTransferData(I2CDEV, &setup, I2C_TRANSFER_POLLING) != SUCCESS)
+        return (-1);
+
+    return (0);
+}
+
 static uint8_t getStatus(void)
 {
-    uint8_t buf[1];
+    uint8_t status = 0;
 
-    buf[0] = ACC_ADDR_STATUS;
-    I2CWrite(ACC_I2C_ADDR, buf, 1);
-    I2CRead(ACC_I2C_ADDR, buf, 1);
+    /* a failed read reports "not ready" */
+    if (readReg(ACC_ADDR_STATUS, &status) != 0)
+        return 0;
 
-    return buf[0];
+    return status;
 }
 
 static uint8_t getModeControl(void)
 {
-    uint8_t buf[1];
+    uint8_t mctl = 0;
 
-    buf[0] = ACC_ADDR_MCTL;
-    I2CWrite(ACC_I2C_ADDR, buf, 1);
-    I2CRead(ACC_I2C_ADDR, buf, 1);
+    readReg(ACC_ADDR_MCTL, &mctl);
 
-    return buf[0];
+    return mctl;
 }
 
 static void setModeControl(uint8_t mctl)
@@ -141,10 +230,145 @@ static void setModeControl(uint8_t mctl)
     I2CWrite(ACC_I2C_ADDR, buf, 2);
 }
 
+static int writeReg(uint8_t reg, uint8_t val)
+{
+    uint8_t buf[2];
+
+    buf[0] = reg;
+    buf[1] = val;
+    return I2CWrite(ACC_I2C_ADDR, buf, 2);
+}
+
+/*
+ * The drift offsets are 11 bit two's complement, one LSB is half a count
+ * of the 8 bit 2g output
+ */
+static void setOffsets(int16_t x, int16_t y, int16_t z)
+{
+    writeReg(ACC_ADDR_XOFFL, (uint8_t)x);
+    writeReg(ACC_ADDR_XOFFH, (uint8_t)((x >> 8) & 0x07));
+    writeReg(ACC_ADDR_YOFFL, (uint8_t)y);
+    writeReg(ACC_ADDR_YOFFH, (uint8_t)((y >> 8) & 0x07));
+    writeReg(ACC_ADDR_ZOFFL, (uint8_t)z);
+    writeReg(ACC_ADDR_ZOFFH, (uint8_t)((z >> 8) & 0x07));
+}
+
+/*
+ * Take I2C2 from interrupt context. Fails if the interrupted code is in
+ * a transfer, the tick and the EINT3 handler can also preempt each other.
+ */
+static int claimBus(void)
+{
+    __disable_irq();
+    if (reading || I2C_MasterIsBusy(I2CDEV) == SET) {
+        __enable_irq();
+        return (-1);
+    }
+    reading = 1;
+    __enable_irq();
+
+    return (0);
+}
+
+static void releaseBus(void)
+{
+    reading = 0;
+}
+
 /******************************************************************************
  * Local Functions
  *****************************************************************************/
 
+/* The six 10 bit output registers in one transfer, with a repeated start */
+static int readOutputs(int16_t *x, int16_t *y, int16_t *z)
+{
+    I2C_M_SETUP_Type setup;
+    uint8_t reg = ACC_ADDR_XOUTL;
+    uint8_t buf[6];
+
+    setup.sl_addr7bit = ACC_I2C_ADDR;
+    setup.tx_data = &reg;
+    setup.tx_length = 1;
+    setup.rx_data = buf;
+    setup.rx_length = 6;
+    setup.retransmissions_max = 3;
+
+    if (I2C_MasterTransferData(I2CDEV, &setup, I2C_TRANSFER_POLLING) != SUCCESS)
+        return (-1);
+
+    *x = ACC_10BIT(buf[0], buf[1]);
+    *y = ACC_10BIT(buf[2], buf[3]);
+    *z = ACC_10BIT(buf[4], buf[5]);
+
+    return (0);
+}
+
+static int8_t saturate8(int16_t v)
+{
+    if (v > 127)
+        return 127;
+    if (v < -128)
+        return -128;
+    return (int8_t)v;
+}
+
+static int16_t abs16(int16_t v)
+{
+    return (v < 0) ? -v : v;
+}
+
+/*
+ * A sample for the ring, 1/64 g at any range. top gets the largest
+ * output on any axis before saturation.
+ */
+static int readSample(acc_sample_t *sample, int16_t *top)
+{
+    int16_t x, y, z;
+
+    if (readOutputs(&x, &y, &z) != 0)
+        return (-1);
+
+    sample->x = saturate8(x);
+    sample->y = saturate8(y);
+    sample->z = saturate8(z);
+    sample->pad = 0;
+
+    x = abs16(x);
+    y = abs16(y);
+    z = abs16(z);
+    *top = (x > y) ? x : y;
+    if (z > *top)
+        *top = z;
+
+    return (0);
+}
+
+/* GPIO input with a pull-down, on port ACC_INT1_PORT */
+static void configIntPin(uint8_t pin)
+{
+    PINSEL_CFG_Type pinCfg;
+
+    pinCfg.Portnum = ACC_INT1_PORT;
+    pinCfg.Pinnum = pin;
+    pinCfg.Funcnum = 0;
+    pinCfg.Pinmode = PINSEL_PINMODE_PULLDOWN;
+    pinCfg.OpenDrain = PINSEL_PINMODE_NORMAL;
+    PINSEL_ConfigPin(&pinCfg);
+}
+
+/* Wait for the data ready flag */
+static int waitReady(void)
+{
+    uint32_t polls = 0;
+
+    while ((getStatus() & ACC_STATUS_DRDY) == 0) {
+        if (++polls >= ACC_DRDY_MAX_POLLS)
+            return (-1);
+    }
+
+    return (0);
+}
+
 /******************************************************************************
  * Public Functions
  *****************************************************************************/
@@ -158,11 +382,14 @@ static void setModeControl(uint8_t mctl)
 void acc_init (void)
 {
 
-    /* set to measurement mode by default */
+    /* set to measurement mode by default, DRDY is output on INT1 */
 
     setModeControl( (ACC_MCTL_MODE(ACC_MODE_MEASURE)
             | ACC_MCTL_GLVL(ACC_RANGE_2G) ));
 
+    configIntPin(ACC_INT1_NUM);
+    configIntPin(ACC_INT2_NUM);
+    GPIO_SetDir(ACC_INT1_PORT, ACC_INT1_PIN | ACC_INT2_PIN, 0);
 }
 
 /******************************************************************************
@@ -175,54 +402,75 @@ void acc_init (void)
  *   [out] y - read y value
  *   [out] z - read z value
  *
+ * Returns:
+ *    0 on success, -1 if the sensor did not become ready or the
+ *    I2C bus timed out. x, y and z are left untouched on failure.
+ *
  *****************************************************************************/
-void acc_read (int8_t *x, int8_t *y, int8_t *z)
+int32_t acc_read (int8_t *x, int8_t *y, int8_t *z)
 {
-    uint8_t buf[1];
+    uint8_t bx, by, bz;
 
     /* wait for ready flag */
-    while ((getStatus() & ACC_STATUS_DRDY) == 0);
+    if (waitReady() != 0)
+        return (-1);
 
     /*
      * Have experienced problems reading all registers88
      * at once. Change to reading them one-by-one.
      */
-    buf[0] = ACC_ADDR_XOUT8;
-    I2CWrite(ACC_I2C_ADDR, buf, 1);
-    I2CRead(ACC_I2C_ADDR, buf, 1);
-
-    *x = (int8_t)buf[0];
+    if (readReg(ACC_ADDR_XOUT8, &bx) != 0
+            || readReg(ACC_ADDR_YOUT8, &by) != 0
+            || readReg(ACC_ADDR_ZOUT8, &bz) != 0)
+        return (-1);
 
-    buf[0] = ACC_ADDR_YOUT8;
-    I2CWrite(ACC_I2C_ADDR, buf, 1);
-    I2CRead(ACC_I2C_ADDR, buf, 1);
+    *x = (int8_t)bx;
+    *y = (int8_t)by;
+    *z = (int8_t)bz;
 
-    *y = (int8_t)buf[0];
+    return (0);
+}
 
-    buf[0] = ACC_ADDR_ZOUT8;
-    I2CWrite(ACC_I2C_ADDR, buf, 1);
-    I2CRead(ACC_I2C_ADDR, buf, 1);
+/******************************************************************************
+ *
+ * Description:
+ *    Read the 10 bit outputs, 64 counts per g at any g-range
+ *
+ * Params:
+ *   [out] x - read x value
+ *   [out] y - read y value
+ *   [out] z - read z value
+ *
+ * Returns:
+ *    0 on success, -1 if the sensor did not become ready or the
+ *    I2C bus timed out. x, y and z are left untouched on failure.
+ *
+ *****************************************************************************/
+int32_t acc_read10 (int16_t *x, int16_t *y, int16_t *z)
+{
+    if (waitReady() != 0)
+        return (-1);
 
-    *z = (int8_t)buf[0];
+    return readOutputs(x, y, z);
 }
 
 /******************************************************************************
  *
  * Description:
- *    Set the g-Range
+ *    Set the g-Range of the 8 bit outputs
  *
  * Params:
  *   [in] range - the g-Range
  *
  *****************************************************************************/
-void acc_setRange(acc_range_t range)
+void acc_setRange(acc_range_t newRange)
 {
     uint8_t mctl = 0;
 
     mctl = getModeControl();
 
     mctl &= ~(0x03 << 2);
-    mctl |= ACC_MCTL_GLVL(range);
+    mctl |= ACC_MCTL_GLVL(newRange);
 
     setModeControl(mctl);
 }
@@ -248,3 +496,333 @@ void acc_setMode(acc_mode_t mode)
     setModeControl(mctl);
 }
 
+/******************************************************************************
+ *
+ * Description:
+ *    Start reading every new output into the sample ring. The DRDY
+ *    interrupt is enabled on the INT1 pin, the EINT3 handler must call
+ *    acc_drdy().
+ *
+ *****************************************************************************/
+void acc_startSampling(void)
+{
+    ringHead = 0;
+    ringTail = 0;
+    ringOverflows = 0;
+    peak = 0;
+    sampling = 1;
+
+    LPC_GPIOINT->IO2IntClr = ACC_INT1_PIN;
+    LPC_GPIOINT->IO2IntEnR |= ACC_INT1_PIN;
+
+    /* an output that was ready before the edge interrupt was enabled */
+    if (ACC_INT1_STATE)
+        drdyPending = 1;
+    acc_drdy();
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Stop filling the sample ring, samples already in it can still be read
+ *
+ *****************************************************************************/
+void acc_stopSampling(void)
+{
+    LPC_GPIOINT->IO2IntEnR &= ~ACC_INT1_PIN;
+    LPC_GPIOINT->IO2IntClr = ACC_INT1_PIN;
+    sampling = 0;
+    drdyPending = 0;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Data ready event, call it from the EINT3 handler. It clears the pin's
+ *    interrupt and reads the sample on a rising edge of DRDY. If I2C2 is
+ *    in use by the interrupted code the read is deferred, so this is also
+ *    called from a periodic tick shorter than the 8 ms output period to
+ *    pick up such a sample. Without an edge or a deferred read it does
+ *    nothing.
+ *
+ *****************************************************************************/
+void acc_drdy(void)
+{
+    acc_sample_t sample;
+    int16_t top;
+    uint32_t next;
+
+    if (LPC_GPIOINT->IO2IntStatR & ACC_INT1_PIN) {
+        LPC_GPIOINT->IO2IntClr = ACC_INT1_PIN;
+        if (sampling)
+            drdyPending = 1;
+    }
+
+    if (!drdyPending)
+        return;
+
+    if (claimBus() != 0)
+        return;
+
+    drdyPending = 0;
+
+    if (readSample(&sample, &top) == 0) {
+        if (top > peak)
+            peak = top;
+        next = (ringHead + 1) & (ACC_RING_SIZE - 1);
+        if (next == ringTail) {
+            ringOverflows++;
+        } else {
+            ring[ringHead] = sample;
+            ringHead = next;
+        }
+    }
+
+    releaseBus();
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Take samples out of the ring, oldest first
+ *
+ * Params:
+ *   [out] buf - where the samples are copied to
+ *   [in] max - room in buf
+ *
+ * Returns:
+ *    Number of samples copied, 0 if the ring is empty
+ *
+ *****************************************************************************/
+uint32_t acc_getSamples(acc_sample_t *buf, uint32_t max)
+{
+    uint32_t head = ringHead;
+    uint32_t tail = ringTail;
+    uint32_t n = 0;
+
+    while (tail != head && n < max) {
+        buf[n++] = ring[tail];
+        tail = (tail + 1) & (ACC_RING_SIZE - 1);
+    }
+    ringTail = tail;
+
+    return n;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Number of samples dropped because the ring was full
+ *
+ *****************************************************************************/
+uint32_t acc_getOverflowCount(void)
+{
+    return ringOverflows;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Take the largest output on any axis since the last call, or since
+ *    sampling was started. Unlike the ring it is not saturated at 2g.
+ *
+ * Returns:
+ *    The 10 bit output, 64 counts per g, 0 to 512
+ *
+ *****************************************************************************/
+uint32_t acc_takePeak(void)
+{
+    int16_t p;
+
+    __disable_irq();
+    p = peak;
+    peak = 0;
+    __enable_irq();
+
+    return (uint32_t)p;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Let the sensor detect movement. Sampling is stopped, the offset
+ *    registers are loaded with the rest position and level and pulse
+ *    detection are armed with the same threshold on all axes.
+ *
+ * Params:
+ *   [in] threshold - change from rest that counts as movement, in mg.
+ *                    The sensor resolution is 62.5 mg.
+ *   [in] restPos - sensor output at rest in 1/64 g, as returned by
+ *                  acc_read() at 2g
+ *
+ *****************************************************************************/
+void acc_startMotionDetect(uint32_t threshold, const acc_sample_t *restPos)
+{
+    uint32_t th;
+    uint8_t mctl;
+
+    acc_stopSampling();
+
+    /* round up, a threshold of 0 would fire all the time */
+    th = (threshold * 1000 + ACC_THRESHOLD_LSB_UG - 1) / ACC_THRESHOLD_LSB_UG;
+    if (th == 0)
+        th = 1;
+    if (th > ACC_THRESHOLD_MAX)
+        th = ACC_THRESHOLD_MAX;
+
+    rest = *restPos;
+    setOffsets(-2 * rest.x, -2 * rest.y, -2 * rest.z);
+
+    writeReg(ACC_ADDR_LDTH, (uint8_t)th);
+    writeReg(ACC_ADDR_PDTH, (uint8_t)th);
+    writeReg(ACC_ADDR_PW, ACC_PULSE_WIDTH);
+    writeReg(ACC_ADDR_CTL1, ACC_CTL1_INTREG(0));
+    writeReg(ACC_ADDR_CTL2, 0);
+
+    /* level detection also runs in pulse detection mode */
+    mctl = getModeControl();
+    mctl &= ~(0x03 << 0);
+    mctl |= ACC_MCTL_MODE(ACC_MODE_PULSE);
+    setModeControl(mctl);
+
+    writeReg(ACC_ADDR_INTRST, ACC_INTRST_CLR_INT1 | ACC_INTRST_CLR_INT2);
+    writeReg(ACC_ADDR_INTRST, 0);
+
+    motion = 0;
+    detecting = 1;
+
+    LPC_GPIOINT->IO2IntClr = ACC_INT1_PIN | ACC_INT2_PIN;
+    LPC_GPIOINT->IO2IntEnR |= ACC_INT1_PIN | ACC_INT2_PIN;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Stop motion detection and go back to measurement mode without offsets
+ *
+ *****************************************************************************/
+void acc_stopMotionDetect(void)
+{
+    uint8_t mctl;
+
+    LPC_GPIOINT->IO2IntEnR &= ~(ACC_INT1_PIN | ACC_INT2_PIN);
+    LPC_GPIOINT->IO2IntClr = ACC_INT1_PIN | ACC_INT2_PIN;
+    detecting = 0;
+
+    mctl = getModeControl();
+    mctl &= ~(0x03 << 0);
+    mctl |= ACC_MCTL_MODE(ACC_MODE_MEASURE);
+    setModeControl(mctl);
+
+    setOffsets(0, 0, 0);
+    rest.x = 0;
+    rest.y = 0;
+    rest.z = 0;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Level or pulse detected, call it from the EINT3 handler. It clears
+ *    the pins' interrupts and the sensor's latches. Like acc_drdy() it is
+ *    also called from the tick, in case the latches could not be cleared
+ *    because I2C2 was busy.
+ *
+ *****************************************************************************/
+void acc_motionEvent(void)
+{
+    uint32_t pins;
+    uint8_t clr = 0;
+
+    pins = LPC_GPIOINT->IO2IntStatR & (ACC_INT1_PIN | ACC_INT2_PIN);
+    if (pins)
+        LPC_GPIOINT->IO2IntClr = pins;
+
+    if (!detecting)
+        return;
+
+    pins = GPIO_ReadValue(ACC_INT1_PORT) & (ACC_INT1_PIN | ACC_INT2_PIN);
+    if (pins == 0)
+        return;
+
+    if (pins & ACC_INT1_PIN) {
+        motion |= ACC_MOTION_LEVEL;
+        clr |= ACC_INTRST_CLR_INT1;
+    }
+    if (pins & ACC_INT2_PIN) {
+        motion |= ACC_MOTION_PULSE;
+        clr |= ACC_INTRST_CLR_INT2;
+    }
+
+    if (claimBus() != 0)
+        return;
+
+    /* the pins go low while CLR is set and are armed again by writing 0 */
+    if (writeReg(ACC_ADDR_INTRST, clr) == 0)
+        writeReg(ACC_ADDR_INTRST, 0);
+
+    releaseBus();
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Check for movement detected by the sensor without clearing it
+ *
+ *****************************************************************************/
+int32_t acc_motionPending(void)
+{
+    return (motion != 0);
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Take the movement detected by the sensor since the last call
+ *
+ * Returns:
+ *    ACC_MOTION_x bits, 0 if nothing was detected
+ *
+ *****************************************************************************/
+uint8_t acc_getMotion(void)
+{
+    uint8_t m;
+
+    __disable_irq();
+    m = motion;
+    motion = 0;
+    __enable_irq();
+
+    return m;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Read the current output without waiting for data ready, in 1/64 g
+ *    at any g-range. While motion detection runs the rest position is
+ *    added back.
+ *
+ * Params:
+ *   [out] x - read x value
+ *   [out] y - read y value
+ *   [out] z - read z value
+ *
+ * Returns:
+ *    0 on success, -1 if the I2C transfer failed
+ *
+ *****************************************************************************/
+int32_t acc_readLatest (int8_t *x, int8_t *y, int8_t *z)
+{
+    acc_sample_t sample;
+    int16_t top;
+
+    if (readSample(&sample, &top) != 0)
+        return (-1);
+
+    *x = (int8_t)(sample.x + rest.x);
+    *y = (int8_t)(sample.y + rest.y);
+    *z = (int8_t)(sample.z + rest.z);
+
+    return (0);
+}
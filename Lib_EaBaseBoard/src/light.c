@@ -9,6 +9,12 @@
 /*
  * NOTE: I2C must have been initialized before calling any functions in this
  * file.
+ *
+ * The width is a power of 2, so the lux value E = range(k) * DATA / 2^n is
+ * a multiply and a shift. With auto ranging enabled light_read() moves
+ * the range up or down a step when the reading is near the top or the
+ * bottom of the current one, and the interrupt thresholds are converted
+ * again for the new range.
  */
 
 /******************************************************************************
@@ -55,10 +61,23 @@
 #define RANGE_K3 15568
 #define RANGE_K4 62272
 
-#define WIDTH_16_VAL (1 << 16)
-#define WIDTH_12_VAL (1 << 12)
-#define WIDTH_08_VAL (1 << 8)
-#define WIDTH_04_VAL (1 << 4)
+#define WIDTH_16_SHIFT 16
+#define WIDTH_12_SHIFT 12
+#define WIDTH_08_SHIFT 8
+#define WIDTH_04_SHIFT 4
+
+#define NUM_RANGES 4
+
+/*
+ * Auto ranging steps up above 15/16 of full scale and down below 3/16,
+ * which is 3/4 of the next lower range, so a step is not undone by the
+ * next reading.
+ */
+#define AUTO_UP(shift)   (15UL << ((shift) - 4))
+#define AUTO_DOWN(shift) (3UL << ((shift) - 4))
+
+#define TH_LO_SET 0x01
+#define TH_HI_SET 0x02
 
 /******************************************************************************
  * External global variables
@@ -68,8 +87,20 @@
  * Local variables
  *****************************************************************************/
 
+static const uint32_t rangeK[NUM_RANGES] = {
+    RANGE_K1, RANGE_K2, RANGE_K3, RANGE_K4
+};
+
 static uint32_t range = RANGE_K1;
-static uint32_t width = WIDTH_16_VAL;
+static uint8_t rangeIdx = LIGHT_RANGE_1000;
+static uint8_t widthShift = WIDTH_16_SHIFT;
+
+static uint8_t autoRange = 0;
+
+/* Thresholds in lux, converted again when the range changes */
+static uint32_t loLux = 0;
+static uint32_t hiLux = 0;
+static uint8_t thresholdsSet = 0;
 
 /******************************************************************************
  * Local Functions
@@ -135,6 +166,64 @@ static uint8_t readControlReg(void)
     return buf[0];
 }
 
+/* Upper byte of the sensor data for luxTh in range k, saturated */
+static uint8_t thresholdData(uint32_t luxTh, uint32_t k)
+{
+    uint32_t data;
+
+    /* the register holds bits 15:8, narrower results never reach it */
+    if (widthShift < 8)
+        return 0;
+
+    data = (luxTh << (widthShift - 8)) / k;
+
+    return (data > 0xff) ? 0xff : (uint8_t)data;
+}
+
+static void writeThreshold(uint8_t addr, uint32_t luxTh)
+{
+    uint8_t buf[2];
+
+    buf[0] = addr;
+    buf[1] = thresholdData(luxTh, range);
+    I2CWrite(LIGHT_I2C_ADDR, buf, 2);
+}
+
+static void writeRange(uint8_t idx)
+{
+    uint8_t buf[2];
+    uint8_t ctrl = readControlReg();
+
+    /* clear range */
+    ctrl &= ~(3 << 2);
+
+    ctrl |= CTRL_GAIN(idx);
+
+    buf[0] = ADDR_CTRL;
+    buf[1] = ctrl;
+    I2CWrite(LIGHT_I2C_ADDR, buf, 2);
+
+    rangeIdx = idx;
+    range = rangeK[idx];
+
+    if (thresholdsSet & TH_LO_SET)
+        writeThreshold(ADDR_IRQTH_LO, loLux);
+    if (thresholdsSet & TH_HI_SET)
+        writeThreshold(ADDR_IRQTH_HI, hiLux);
+}
+
+/*
+ * Auto ranging must not go to a range where the low threshold is below
+ * one step of the threshold register, the dark interrupt would be lost.
+ */
+static int rangeUsable(uint8_t idx)
+{
+    if (!(thresholdsSet & TH_LO_SET) || loLux == 0)
+        return 1;
+
+    return (thresholdData(loLux, rangeK[idx]) > 0);
+}
+
 /******************************************************************************
  * Public Functions
  *****************************************************************************/
@@ -164,7 +253,8 @@ void light_enable (void)
     I2CWrite(LIGHT_I2C_ADDR, buf, 2);
 
     range = RANGE_K1;
-    width = WIDTH_16_VAL;
+    rangeIdx = LIGHT_RANGE_1000;
+    widthShift = WIDTH_16_SHIFT;
 }
 
 /******************************************************************************
@@ -179,6 +269,7 @@ void light_enable (void)
 uint32_t light_read(void)
 {
     uint32_t data = 0;
+    uint32_t lux;
     uint8_t buf[1];
 
     buf[0] = ADDR_LSB_SENSOR;
@@ -195,9 +286,20 @@ uint32_t light_read(void)
 
 
     /* Rext = 100k */
-    /* E = (range(k) * DATA)  / 2^n */
+    /* E = (range(k) * DATA)  / 2^n, fits in 32 bits for all ranges */
+
+    lux = (range * data) >> widthShift;
 
-    return (range*data / width);
+    /* the reading is valid, the next one is taken in the new range */
+    if (autoRange) {
+        if (data >= AUTO_UP(widthShift) && rangeIdx < NUM_RANGES - 1
+                && rangeUsable(rangeIdx + 1))
+            writeRange(rangeIdx + 1);
+        else if (data < AUTO_DOWN(widthShift) && rangeIdx > 0)
+            writeRange(rangeIdx - 1);
+    }
+
+    return lux;
 }
 
 /******************************************************************************
@@ -249,18 +351,24 @@ void light_setWidth(light_width_t newWidth)
 
     switch(newWidth) {
     case LIGHT_WIDTH_16BITS:
-        width = WIDTH_16_VAL;
+        widthShift = WIDTH_16_SHIFT;
         break;
     case LIGHT_WIDTH_12BITS:
-        width = WIDTH_12_VAL;
+        widthShift = WIDTH_12_SHIFT;
         break;
     case LIGHT_WIDTH_08BITS:
-        width = WIDTH_08_VAL;
+        widthShift = WIDTH_08_SHIFT;
         break;
     case LIGHT_WIDTH_04BITS:
-        width = WIDTH_04_VAL;
+        widthShift = WIDTH_04_SHIFT;
         break;
     }
+
+    /* the thresholds are in units of the data */
+    if (thresholdsSet & TH_LO_SET)
+        writeThreshold(ADDR_IRQTH_LO, loLux);
+    if (thresholdsSet & TH_HI_SET)
+        writeThreshold(ADDR_IRQTH_HI, hiLux);
 }
 
 /******************************************************************************
@@ -274,32 +382,32 @@ void light_setWidth(light_width_t newWidth)
  *****************************************************************************/
 void light_setRange(light_range_t newRange)
 {
-    uint8_t buf[2];
-    uint8_t ctrl = readControlReg();
-
-    /* clear range */
-    ctrl &= ~(3 << 2);
-
-    ctrl |= CTRL_GAIN(newRange);
+    writeRange((uint8_t)newRange);
+}
 
-    buf[0] = ADDR_CTRL;
-    buf[1] = ctrl;
-    I2CWrite(LIGHT_I2C_ADDR, buf, 2);
+/******************************************************************************
+ *
+ * Description:
+ *    Enable or disable auto ranging. The range set last is the start point.
+ *
+ * Params:
+ *    [in]  enable  - TRUE to let light_read() change the range
+ *
+ *****************************************************************************/
+void light_setAutoRange(Bool enable)
+{
+    autoRange = (enable == TRUE);
+}
 
-    switch(newRange) {
-    case LIGHT_RANGE_1000:
-        range = RANGE_K1;
-        break;
-    case LIGHT_RANGE_4000:
-        range = RANGE_K2;
-        break;
-    case LIGHT_RANGE_16000:
-        range = RANGE_K3;
-        break;
-    case LIGHT_RANGE_64000:
-        range = RANGE_K4;
-        break;
-    }
+/******************************************************************************
+ *
+ * Description:
+ *    Get the range in use, it changes with auto ranging
+ *
+ *****************************************************************************/
+light_range_t light_getRange(void)
+{
+    return (light_range_t)rangeIdx;
 }
 
 /******************************************************************************
@@ -313,14 +421,10 @@ void light_setRange(light_range_t newRange)
  *****************************************************************************/
 void light_setHiThreshold(uint32_t luxTh)
 {
-    uint8_t buf[2];
-    uint32_t data = 0;
+    hiLux = luxTh;
+    thresholdsSet |= TH_HI_SET;
 
-    data = luxTh * width / range;
-
-    buf[0] = ADDR_IRQTH_HI;
-    buf[1] = ((data >> 8) & 0xff);
-    I2CWrite(LIGHT_I2C_ADDR, buf, 2);
+    writeThreshold(ADDR_IRQTH_HI, luxTh);
 }
 
 /******************************************************************************
@@ -334,14 +438,22 @@ void light_setHiThreshold(uint32_t luxTh)
  *****************************************************************************/
 void light_setLoThreshold(uint32_t luxTh)
 {
-    uint8_t buf[2];
-    uint32_t data = 0;
-
-    data = luxTh * width / range;
+    uint8_t idx = rangeIdx;
+
+    loLux = luxTh;
+    thresholdsSet |= TH_LO_SET;
+
+    /* with auto ranging step down until the threshold can be seen */
+    if (autoRange) {
+        while (idx > 0 && !rangeUsable(idx))
+            idx--;
+        if (idx != rangeIdx) {
+            writeRange(idx);
+            return;
+        }
+    }
 
-    buf[0] = ADDR_IRQTH_LO;
-    buf[1] = ((data >> 8) & 0xff);
-    I2CWrite(LIGHT_I2C_ADDR, buf, 2);
+    writeThreshold(ADDR_IRQTH_LO, luxTh);
 }
 
 /******************************************************************************
@@ -16,6 +16,7 @@
  *****************************************************************************/
 
 #include "lpc17xx_gpio.h"
+#include "lpc17xx_pinsel.h"
 #include "temp.h"
 
 /******************************************************************************
@@ -34,6 +35,14 @@
  */
 //#define TEMP_USE_P0_2
 
+/*
+ * Both inputs are timed with the RIT counter, free running at CCLK/4.
+ * With the GPIO input only the falling edges interrupt, one per sensor
+ * period, and each takes the RIT count. TEMP_USE_CAP3_0 (temp.h) counts
+ * the periods in hardware instead: TIMER3 counts them on CAP3.0 (P0.23)
+ * and interrupts once per reading.
+ */
+
 #if TEMP_TS1 == 0 && TEMP_TS0 == 0
 #define TEMP_SCALAR_DIV10 1
 #define NUM_HALF_PERIODS 340
@@ -48,6 +57,12 @@
 #define NUM_HALF_PERIODS 10
 #endif
 
+/* Sensor periods in one reading of the precise profile, about 0.5 s */
+#define NUM_PERIODS (NUM_HALF_PERIODS / 2)
+
+/* Time units of a reading per ms, RIT counts */
+#define TEMP_UNITS_PER_MS ((SystemCoreClock / 4) / 1000)
+
 
 #define P0_6_STATE ((GPIO_ReadValue(0) & (1 << 6)) != 0)
 #define P0_2_STATE ((GPIO_ReadValue(0) & (1 << 2)) != 0)
@@ -55,10 +70,19 @@
 
 #ifdef TEMP_USE_P0_6
 #define    GET_TEMP_STATE P0_6_STATE
+#define    TEMP_PIN (1 << 6)
 #else
 #define    GET_TEMP_STATE P0_2_STATE
+#define    TEMP_PIN (1 << 2)
 #endif
 
+typedef enum
+{
+    STATE_IDLE,
+    STATE_SYNC,     /* waiting for the first edge */
+    STATE_COUNT     /* counting half periods */
+} temp_state_t;
+
 
 /******************************************************************************
  * External global variables
@@ -68,12 +92,154 @@
  * Local variables
  *****************************************************************************/
 
-static uint32_t (*getTicks)(void) = NULL;
+static volatile temp_state_t state = STATE_IDLE;
+
+static volatile int32_t lastValue = 0;
+static volatile uint8_t valueReady = 0;
+
+/* Called in interrupt context when a reading is ready, may be NULL */
+static void (*onReady)(void) = NULL;
+
+/* Profile chosen by the user, may be TEMP_PROFILE_AUTO */
+static volatile temp_profile_t selected = TEMP_PROFILE_PRECISE;
+
+/* Profile of the reading in progress */
+static volatile temp_profile_t active = TEMP_PROFILE_PRECISE;
+
+/* Fewer periods for the faster profiles: NUM_PERIODS >> shift */
+static const uint8_t profileShift[TEMP_NUM_PROFILES] = {4, 2, 0};
+
+/* Sensor periods in one reading, per profile */
+static uint32_t profilePeriods[TEMP_NUM_PROFILES];
+
+/*
+ * Fewest periods for one time unit to move a reading by at most 0.1 C.
+ * FAST and NORMAL with fewer are read as PRECISE.
+ */
+static uint32_t minPeriods = 1;
+
+/*
+ * 10T(K) for one RIT count over a reading, per profile, Q32. Worked out
+ * once so a reading needs no division.
+ */
+static uint32_t profileScale[TEMP_NUM_PROFILES];
+
+/* For TEMP_PROFILE_AUTO, 10 x T(C) */
+static volatile int32_t alarmLevel = 0x7FFFFFFF;
+static volatile int32_t alarmBand = 0;
+
+/* RIT count at the end of the previous reading */
+static uint32_t lastCount = 0;
+
+#ifndef TEMP_USE_CAP3_0
+/* Periods of the reading in progress */
+static uint32_t periods = 0;
+#endif
 
 /******************************************************************************
  * Local Functions
  *****************************************************************************/
 
+/* The profile, or PRECISE if the time base is too coarse for it */
+static temp_profile_t usableProfile(temp_profile_t profile)
+{
+    if (profilePeriods[profile] < minPeriods)
+        return TEMP_PROFILE_PRECISE;
+
+    return profile;
+}
+
+/* Profile of the next reading after a reading of value */
+static temp_profile_t nextProfile(int32_t value)
+{
+    int32_t dist;
+
+    if (selected != TEMP_PROFILE_AUTO)
+        return usableProfile(selected);
+
+    dist = value - alarmLevel;
+    if (dist < 0)
+        dist = -dist;
+
+    if (dist <= alarmBand)
+        return usableProfile(TEMP_PROFILE_FAST);
+    if (dist <= 4 * alarmBand)
+        return usableProfile(TEMP_PROFILE_NORMAL);
+
+    return TEMP_PROFILE_PRECISE;
+}
+
+/* Periods and scale of every profile, depends on the core clock */
+static void setupProfiles(void)
+{
+    uint32_t i;
+    uint32_t n;
+
+    /* 10T(K) = ms * 1000 / (periods * scalar_div10) */
+    minPeriods = (1000 + TEMP_UNITS_PER_MS * TEMP_SCALAR_DIV10 - 1)
+            / (TEMP_UNITS_PER_MS * TEMP_SCALAR_DIV10);
+
+    for (i = 0; i < TEMP_NUM_PROFILES; i++) {
+        n = NUM_PERIODS >> profileShift[i];
+        if (n == 0)
+            n = 1;
+        profilePeriods[i] = n;
+
+        /* 10T(K) = counts / (ticksPerUs * periods * scalar_div10) */
+        profileScale[i] = (uint32_t)(0xFFFFFFFFUL /
+                (((SystemCoreClock / 4) / 1000000) * n * TEMP_SCALAR_DIV10)) + 1;
+    }
+}
+
+/* RIT free running from PCLK = CCLK/4 */
+static void startRit(void)
+{
+    LPC_SC->PCONP |= (1 << 16);
+    LPC_SC->PCLKSEL1 &= ~(0x03 << 26);
+    LPC_RIT->RICTRL = 0;
+    LPC_RIT->RICOMPVAL = 0xFFFFFFFF;
+    LPC_RIT->RIMASK = 0;
+    LPC_RIT->RICOUNTER = 0;
+    LPC_RIT->RICTRL = (1 << 3);     // Enable, never cleared on match
+}
+
+static void stopRit(void)
+{
+    LPC_RIT->RICTRL = 0;
+    LPC_SC->PCONP &= ~(1 << 16);
+}
+
+/* A reading ended at RIT count now, runs in interrupt context */
+static void endReading(uint32_t now)
+{
+    lastValue = (int32_t)(((uint64_t)(now - lastCount)
+            * profileScale[active]) >> 32) - 2731;
+    valueReady = 1;
+    active = nextProfile(lastValue);
+    if (onReady != NULL)
+        onReady();
+}
+
+#ifndef TEMP_USE_CAP3_0
+/* A falling edge at RIT count now, one sensor period */
+static void countPeriod(uint32_t now)
+{
+    if (state == STATE_IDLE)
+        return;
+
+    if (state == STATE_COUNT) {
+        if (++periods < profilePeriods[active])
+            return;
+        endReading(now);
+    }
+
+    /* this edge starts the next reading */
+    lastCount = now;
+    periods = 0;
+    state = STATE_COUNT;
+}
+#endif
+
 /******************************************************************************
  * Public Functions
  *****************************************************************************/
@@ -84,24 +250,32 @@ static uint32_t (*getTicks)(void) = NULL;
  *    Initialize Temp Sensor driver
  *
  * Params:
- *   [in] getMsTicks - callback function for retrieving number of elapsed ticks
- *                     in milliseconds
+ *   [in] getMsTicks - not used, the readings are timed with the RIT
  *
  *****************************************************************************/
 void temp_init (uint32_t (*getMsTicks)(void))
 {
-#ifdef TEMP_USE_P0_6
-    GPIO_SetDir( 0, (1<<6), 0 );
+#ifdef TEMP_USE_CAP3_0
+    PINSEL_CFG_Type PinCfg;
+
+    /* P0.23 - CAP3.0 */
+    PinCfg.Funcnum = 3;
+    PinCfg.OpenDrain = 0;
+    PinCfg.Pinmode = 0;
+    PinCfg.Portnum = 0;
+    PinCfg.Pinnum = 23;
+    PINSEL_ConfigPin(&PinCfg);
 #else
-    GPIO_SetDir( 0, (1<<2), 0 );
+    GPIO_SetDir( 0, TEMP_PIN, 0 );
 #endif
-    getTicks = getMsTicks;
 }
 
 /******************************************************************************
  *
  * Description:
- *    Read temperature
+ *    Read temperature, waits for the next reading. With the GPIO input
+ *    this polls the pin itself and must not be used while temp_edge() is
+ *    called from an interrupt.
  *
  * Returns:
  *    10 x T(c), i.e. 10 times the temperature in Celcius. Example:
@@ -110,38 +284,235 @@ void temp_init (uint32_t (*getMsTicks)(void))
  *****************************************************************************/
 int32_t temp_read (void)
 {
-    uint8_t state = 0;
-    uint32_t t1 = 0;
-    uint32_t t2 = 0;
-    int i = 0;
+    int32_t value;
+#ifndef TEMP_USE_CAP3_0
+    uint8_t pinState = GET_TEMP_STATE;
+    uint8_t level;
+#endif
+
+    temp_start();
+
+    while (!temp_poll(&value)) {
+#ifndef TEMP_USE_CAP3_0
+        level = GET_TEMP_STATE;
+        if (pinState && !level)
+            countPeriod(LPC_RIT->RICOUNTER);
+        pinState = level;
+#endif
+    }
+
+    return value;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Start measuring in the background. A new reading is ready every
+ *    reading of the active profile, see temp_setProfile(). Does nothing
+ *    if the measurement is running already.
+ *
+ *    With the GPIO input the falling edge interrupt of the pin is enabled
+ *    and the EINT3 handler must call temp_edge().
+ *
+ *****************************************************************************/
+void temp_start (void)
+{
+    if (state != STATE_IDLE)
+        return;
 
+    valueReady = 0;
+    setupProfiles();
+
+    /* the first reading in auto mode is a quick one */
+    active = usableProfile((selected == TEMP_PROFILE_AUTO)
+            ? TEMP_PROFILE_FAST : selected);
+
+    startRit();
+
+#ifdef TEMP_USE_CAP3_0
     /*
-     * T(C) = ( period (us) / scalar ) - 273.15 K
-     *
-     * 10T(C) = (period (us) / scalar_div10) - 2731 K
+     * TIMER3 counts falling edges on CAP3.0 and is never reset, MR0 is
+     * moved on by the periods of the next reading in every interrupt.
      */
+    LPC_SC->PCONP |= (1 << 23);
+    LPC_TIM3->TCR = (1 << 1);       // Reset
+    LPC_TIM3->CTCR = 0x02;          // Counter mode, falling edge, CAP3.0
+    LPC_TIM3->PR = 0;
+    LPC_TIM3->MR0 = 1;              // First edge starts the first reading
+    LPC_TIM3->MCR = (1 << 0);       // Interrupt on MR0
+    LPC_TIM3->IR = LPC_TIM3->IR;
 
-    state = GET_TEMP_STATE;
+    state = STATE_SYNC;
 
-    /* get next state change before measuring time */
-    while(GET_TEMP_STATE == state);
-    state = !state;
+    NVIC_ClearPendingIRQ(TIMER3_IRQn);
+    NVIC_EnableIRQ(TIMER3_IRQn);
+    LPC_TIM3->TCR = (1 << 0);
+#else
+    state = STATE_SYNC;
 
-    t1 = getTicks();
+    LPC_GPIOINT->IO0IntClr = TEMP_PIN;
+    LPC_GPIOINT->IO0IntEnF |= TEMP_PIN;
+#endif
+}
 
-    for (i = 0; i < NUM_HALF_PERIODS; i++) {
-        while(GET_TEMP_STATE == state);
-        state = !state;
-    }
+/******************************************************************************
+ *
+ * Description:
+ *    Stop measuring, the reading in progress is dropped. The RIT, and
+ *    TIMER3 with the timer counter, are powered down.
+ *
+ *****************************************************************************/
+void temp_stop (void)
+{
+#ifdef TEMP_USE_CAP3_0
+    NVIC_DisableIRQ(TIMER3_IRQn);
+    LPC_TIM3->TCR = 0;
+    LPC_TIM3->MCR = 0;
+    LPC_TIM3->IR = LPC_TIM3->IR;
+    LPC_SC->PCONP &= ~(1 << 23);
+#else
+    LPC_GPIOINT->IO0IntEnF &= ~TEMP_PIN;
+    LPC_GPIOINT->IO0IntClr = TEMP_PIN;
+#endif
+    stopRit();
 
-    t2 = getTicks();
-    if (t2 > t1) {
-        t2 = t2-t1;
-    }
-    else {
-        t2 = (0xFFFFFFFF - t1 + 1) + t2;
-    }
+    state = STATE_IDLE;
+    valueReady = 0;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Get the latest reading without waiting
+ *
+ * Params:
+ *   [out] value - 10 x T(C), only written when a new reading is returned
+ *
+ * Returns:
+ *    1 if a reading completed since the last call, otherwise 0
+ *
+ *****************************************************************************/
+uint32_t temp_poll (int32_t *value)
+{
+    if (!valueReady)
+        return 0;
+
+    /* the reading is one word, it cannot change half way */
+    *value = lastValue;
+    valueReady = 0;
+
+    return 1;
+}
 
+/******************************************************************************
+ *
+ * Description:
+ *    Set a function to call when a reading is ready, e.g. to wake the main
+ *    loop. It runs in interrupt context, temp_poll() takes the reading.
+ *
+ * Params:
+ *   [in] handler - the function, NULL for none
+ *
+ *****************************************************************************/
+void temp_setReadyHandler (void (*handler)(void))
+{
+    onReady = handler;
+}
 
-    return ( (2*1000*t2) / (NUM_HALF_PERIODS*TEMP_SCALAR_DIV10) - 2731 );
+/******************************************************************************
+ *
+ * Description:
+ *    Select the conversion profile. FAST counts NUM_PERIODS/16 sensor
+ *    periods per reading, NORMAL NUM_PERIODS/4 and PRECISE NUM_PERIODS,
+ *    about 30 ms, 125 ms and 0.5 s at room temperature with TS1/TS0 = 0/0.
+ *    AUTO picks one after every reading, see temp_setAlarmLevel(). The
+ *    change takes effect from the next reading. FAST and NORMAL are only
+ *    used when one RIT count is at most 0.1 C of them, else PRECISE is
+ *    used instead. At any usable core clock they are.
+ *
+ * Params:
+ *   [in] profile - TEMP_PROFILE_x
+ *
+ *****************************************************************************/
+void temp_setProfile (temp_profile_t profile)
+{
+    if (profile > TEMP_PROFILE_AUTO)
+        return;
+
+    selected = profile;
 }
+
+/******************************************************************************
+ *
+ * Description:
+ *    Get the profile of the reading in progress
+ *
+ * Returns:
+ *    TEMP_PROFILE_FAST, TEMP_PROFILE_NORMAL or TEMP_PROFILE_PRECISE
+ *
+ *****************************************************************************/
+temp_profile_t temp_getProfile (void)
+{
+    return active;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Set where TEMP_PROFILE_AUTO needs fast readings. Within band of the
+ *    level it uses FAST, within 4 x band NORMAL and PRECISE further away.
+ *
+ * Params:
+ *   [in] level - alarm level, 10 x T(C)
+ *   [in] band - 10 x T(C)
+ *
+ *****************************************************************************/
+void temp_setAlarmLevel (int32_t level, int32_t band)
+{
+    alarmLevel = level;
+    alarmBand = (band < 0) ? -band : band;
+}
+
+/******************************************************************************
+ *
+ * Description:
+ *    Sensor edge event for the GPIO input, call it from the EINT3 handler.
+ *    On a falling edge of the pin it clears the interrupt and counts one
+ *    sensor period at the current RIT count, otherwise it does nothing.
+ *    Does nothing with the TIMER3 input.
+ *
+ *****************************************************************************/
+void temp_edge (void)
+{
+#ifndef TEMP_USE_CAP3_0
+    uint32_t now = LPC_RIT->RICOUNTER;
+
+    if ((LPC_GPIOINT->IO0IntStatF & TEMP_PIN) == 0)
+        return;
+
+    LPC_GPIOINT->IO0IntClr = TEMP_PIN;
+    countPeriod(now);
+#endif
+}
+
+#ifdef TEMP_USE_CAP3_0
+/******************************************************************************
+ *
+ * Description:
+ *    TIMER3 interrupt, the sensor periods of a reading have been counted
+ *
+ *****************************************************************************/
+void TIMER3_IRQHandler (void)
+{
+    uint32_t now = LPC_RIT->RICOUNTER;
+
+    LPC_TIM3->IR = LPC_TIM3->IR;
+
+    if (state == STATE_COUNT)
+        endReading(now);
+
+    LPC_TIM3->MR0 += profilePeriods[active];
+    lastCount = now;
+    state = STATE_COUNT;
+}
+#endif
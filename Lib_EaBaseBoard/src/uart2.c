@@ -38,6 +38,8 @@
 #define R_LSR 0x05
 #define R_MSR 0x06
 
+#define R_TXLVL  0x08
+#define R_RXLVL  0x09
 #define R_IOCTRL 0x0E
 #define R_EFCR   0x0F
 
@@ -51,6 +53,17 @@
 #define LSR_THRE	0x20
 #define LSR_RDR		0x01
 
+#define FCR_FIFO_EN   0x01
+#define FCR_RX_RESET  0x02
+#define FCR_TX_RESET  0x04
+
+/*
+ * Size of the TX and RX FIFOs. The sub-address is not incremented while
+ * THR/RHR is accessed, so all bytes of one I2C transfer go through the
+ * FIFO.
+ */
+#define FIFO_SIZE 64
+
 /******************************************************************************
  * External global variables
  *****************************************************************************/
@@ -121,6 +134,28 @@ static uint8_t readReg(uint8_t reg)
     return buf[0];
 }
 
+/* Write len (at most FIFO_SIZE) bytes to THR in one I2C transfer */
+static void writeFifo(uint8_t *data, uint32_t len)
+{
+    uint8_t buf[FIFO_SIZE + 1];
+    uint32_t i;
+
+    buf[0] = SUB_ADDR(channel, R_THR);
+    for (i = 0; i < len; i++)
+        buf[i + 1] = data[i];
+    I2CWrite(UART2_ADDR, buf, len + 1);
+}
+
+/* Read len bytes from RHR in one I2C transfer */
+static void readFifo(uint8_t *data, uint32_t len)
+{
+    uint8_t buf[1];
+
+    buf[0] = SUB_ADDR(channel, R_RHR);
+    I2CWrite(UART2_ADDR, buf, 1);
+    I2CRead(UART2_ADDR, data, len);
+}
+
 
 /******************************************************************************
  * Public Functions
@@ -183,6 +218,9 @@ void uart2_setBaudRate(uint32_t baudRate)
 
     /* line control  */
     writeReg(R_LCR, 0x03); // 8 bit data, 1 stop bit, no parity
+
+    /* enable and clear the FIFOs, uart2_send and uart2_receive use them */
+    writeReg(R_FCR, FCR_FIFO_EN | FCR_RX_RESET | FCR_TX_RESET);
 }
 
 /******************************************************************************
@@ -197,6 +235,8 @@ void uart2_setBaudRate(uint32_t baudRate)
  *****************************************************************************/
 void uart2_send(uint8_t *buffer, uint32_t length)
 {
+    uint32_t space;
+
     if (!buffer) {
         /* error */
         return;
@@ -204,13 +244,20 @@ void uart2_send(uint8_t *buffer, uint32_t length)
 
     while ( length != 0 )
     {
-        /* THRE status, contain valid data */
-        while ( !(readReg(R_LSR) & LSR_THRE) );
+        /* free space in the TX FIFO */
+        space = readReg(R_TXLVL);
+        if (space == 0)
+            continue;
 
-        writeReg(R_THR, *buffer);
+        if (space > FIFO_SIZE)
+            space = FIFO_SIZE;
+        if (space > length)
+            space = length;
 
-        buffer++;
-        length--;
+        writeFifo(buffer, space);
+
+        buffer += space;
+        length -= space;
     }
     return;
 }
@@ -226,19 +273,17 @@ void uart2_send(uint8_t *buffer, uint32_t length)
  *****************************************************************************/
 void uart2_sendString(uint8_t *string)
 {
+    uint32_t len = 0;
+
     if (!string) {
         /* error */
         return;
     }
 
-    while ( *string != '\0' )
-    {
-        /* THRE status, contain valid data */
-        while ( !(readReg(R_LSR) & LSR_THRE) );
-        writeReg(R_THR, *string);
+    while ( string[len] != '\0' )
+        len++;
 
-        string++;
-    }
+    uart2_send(string, len);
 
     return;
 }
@@ -258,33 +303,25 @@ uint32_t uart2_receive(uint8_t *buffer, uint32_t length, uint32_t blocking)
 {
     uint32_t recvd = 0;
     uint32_t toRecv = length;
-
-    if (blocking) {
-
-        while (toRecv) {
-            /* wait for data */
-            while (!(readReg(R_LSR) & LSR_RDR));
-
-            *buffer++ = readReg(R_RHR);
-
-            recvd++;
-            toRecv--;
+    uint32_t avail;
+
+    while (toRecv) {
+        /* bytes waiting in the RX FIFO */
+        avail = readReg(R_RXLVL);
+        if (avail == 0) {
+            if (blocking)
+                continue;
+            break;
         }
 
-    }
-    else {
-
-        while (toRecv) {
-            /* break if no data */
-            if (!(readReg(R_LSR) & LSR_RDR)) {
-                break;
-            }
+        if (avail > toRecv)
+            avail = toRecv;
 
-            *buffer++ = readReg(R_RHR);
+        readFifo(buffer, avail);
 
-            recvd++;
-            toRecv--;
-        }
+        buffer += avail;
+        recvd += avail;
+        toRecv -= avail;
     }
 
     return recvd;
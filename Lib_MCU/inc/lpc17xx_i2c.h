@@ -167,6 +167,16 @@ extern "C"
 /** Time out in case of using I2C slave mode */
 #define I2C_SLAVE_TIME_OUT						0x10000UL
 
+/** Time out (in micro-seconds) for each SI wait in master polling mode.
+ * The deadline is measured with the core cycle counter, so it does not
+ * depend on optimisation level or bus clock */
+#ifndef I2C_MASTER_TIME_OUT_US
+#define I2C_MASTER_TIME_OUT_US					1000UL
+#endif
+
+/** Maximum number of SCL pulses generated during bus recovery */
+#define I2C_RECOVERY_SCL_PULSES					9
+
 /********************************************************************//**
  * I2C Data register definition
  *********************************************************************/
@@ -296,6 +306,16 @@ typedef struct
   void 				(*callback)(void);
 } I2C_S_SETUP_Type;
 
+/** @brief Bus recovery pin setup structure definitions
+ * All I2C pins on LPC17xx are located on port 0 */
+typedef struct
+{
+  uint8_t			SclPinnum;					/**< Pin number of SCL on port 0 */
+  uint8_t			SdaPinnum;					/**< Pin number of SDA on port 0 */
+  uint8_t			Funcnum;					/**< Pin function that selects I2C
+													  on these pins */
+} I2C_RECOVERY_CFG_Type;
+
 /**
  * @brief Transfer option type definitions
  */
@@ -326,6 +346,7 @@ typedef enum {
 #define I2C_SETUP_STATUS_ARBF   (1<<8)	/**< Arbitration false */
 #define I2C_SETUP_STATUS_NOACKF (1<<9)	/**< No ACK returned */
 #define I2C_SETUP_STATUS_DONE   (1<<10)	/**< Status DONE */
+#define I2C_SETUP_STATUS_TIMEOUT (1<<11)	/**< Bus time-out, bus has been recovered */
 
 
 /*********************************************************************//**
@@ -355,6 +376,10 @@ Status I2C_MasterTransferData(LPC_I2C_TypeDef *I2Cx, \
 		I2C_M_SETUP_Type *TransferCfg, I2C_TRANSFER_OPT_Type Opt);
 Status I2C_SlaveTransferData(LPC_I2C_TypeDef *I2Cx, \
 		I2C_S_SETUP_Type *TransferCfg, I2C_TRANSFER_OPT_Type Opt);
+FlagStatus I2C_MasterIsBusy(LPC_I2C_TypeDef *I2Cx);
+
+void I2C_SetRecoveryPins(LPC_I2C_TypeDef *I2Cx, I2C_RECOVERY_CFG_Type *RecoveryCfg);
+void I2C_BusRecovery(LPC_I2C_TypeDef *I2Cx);
 
 void I2C_SetOwnSlaveAddr(LPC_I2C_TypeDef *I2Cx, I2C_OWNSLAVEADDR_CFG_Type *OwnSlaveAddrConfigStruct);
 uint8_t I2C_GetLastStatusCode(LPC_I2C_TypeDef* I2Cx);
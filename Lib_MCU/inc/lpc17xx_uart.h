@@ -579,6 +579,7 @@ typedef void (fnModemCbs_Type)(uint8_t ModemStatus);
 void UART_DeInit(LPC_UART_TypeDef* UARTx);
 void UART_Init(LPC_UART_TypeDef *UARTx, UART_CFG_Type *UART_ConfigStruct);
 void UART_ConfigStructInit(UART_CFG_Type *UART_InitStruct);
+Status UART_SetBaudrate(LPC_UART_TypeDef *UARTx, uint32_t baudrate);
 void UART_SendData(LPC_UART_TypeDef* UARTx, uint8_t Data);
 uint8_t UART_ReceiveData(LPC_UART_TypeDef* UARTx);
 void UART_ForceBreak(LPC_UART_TypeDef* UARTx);
@@ -42,6 +42,21 @@
 #ifdef _I2C
 
 
+/* Private Macros ------------------------------------------------------------- */
+/** @defgroup I2C_Private_Macros
+ * @{
+ */
+
+/** Cortex-M3 DWT cycle counter, used for the master polling deadline */
+#define I2C_DWT_CTRL			(*((volatile uint32_t *) 0xE0001000))
+#define I2C_DWT_CYCCNT			(*((volatile uint32_t *) 0xE0001004))
+#define I2C_DWT_CTRL_CYCCNTENA	((1<<0))
+
+/**
+ * @}
+ */
+
+
 /* Private Types -------------------------------------------------------------- */
 /** @defgroup I2C_Private_Types
  * @{
@@ -67,6 +82,27 @@ typedef struct
  */
 static I2C_CFG_T i2cdat[3];
 
+/**
+ * @brief Number of core cycles to wait for SI before the bus is declared stuck
+ */
+static uint32_t i2ctimeout = 0;
+
+/**
+ * @brief Bus recovery pins for I2C0, I2C1 and I2C2, default to the
+ * P0.27/P0.28, P0.19/P0.20 and P0.10/P0.11 pin-outs
+ */
+static I2C_RECOVERY_CFG_Type i2crecovery[3] = {
+		{28, 27, 1},
+		{20, 19, 3},
+		{11, 10, 2},
+};
+
+/**
+ * @brief Set while a polling master transfer is in progress on I2C0,
+ * I2C1 or I2C2, see I2C_MasterIsBusy()
+ */
+static volatile uint8_t i2cbusy[3];
+
 
 
 /* Private Functions ---------------------------------------------------------- */
@@ -95,6 +131,12 @@ void I2C_SlaveHandler (LPC_I2C_TypeDef *I2Cx);
 /* Enable interrupt for I2C device */
 void I2C_IntCmd (LPC_I2C_TypeDef *I2Cx, Bool NewState);
 
+/* Wait for SI flag with a deadline */
+static Bool I2C_WaitSI (LPC_I2C_TypeDef *I2Cx);
+
+/* Busy wait for a number of core cycles */
+static void I2C_Delay (uint32_t cycles);
+
 /*--------------------------------------------------------------------------------*/
 
 /**
@@ -117,7 +159,8 @@ static int32_t I2C_getNum(LPC_I2C_TypeDef *I2Cx){
  * Parameters:
  *     i2cdev: Pointer to I2C register
  *     blocking: blocking or none blocking mode
- * Returns: value of I2C status register after generate a start condition
+ * Returns: value of I2C status register after generate a start condition,
+ *          or I2C_SETUP_STATUS_TIMEOUT if SI was not set in time
  **********************************************************************/
 static uint32_t I2C_Start (LPC_I2C_TypeDef *I2Cx)
 {
@@ -125,7 +168,9 @@ static uint32_t I2C_Start (LPC_I2C_TypeDef *I2Cx)
 	I2Cx->I2CONSET = I2C_I2CONSET_STA;
 
 	// Wait for complete
-	while (!(I2Cx->I2CONSET & I2C_I2CONSET_SI));
+	if (!I2C_WaitSI(I2Cx)){
+		return (I2C_SETUP_STATUS_TIMEOUT);
+	}
 	I2Cx->I2CONCLR = I2C_I2CONCLR_STAC;
 	return (I2Cx->I2STAT & I2C_STAT_CODE_BITMASK);
 }
@@ -156,7 +201,8 @@ static void I2C_Stop (LPC_I2C_TypeDef *I2Cx)
  * Purpose: Send a byte
  * Parameters:
  *     I2Cx: Pointer to I2C register
- * Returns: value of I2C status register after sending
+ * Returns: value of I2C status register after sending,
+ *          or I2C_SETUP_STATUS_TIMEOUT if SI was not set in time
  **********************************************************************/
 static uint32_t I2C_SendByte (LPC_I2C_TypeDef *I2Cx, uint8_t databyte)
 {
@@ -168,7 +214,9 @@ static uint32_t I2C_SendByte (LPC_I2C_TypeDef *I2Cx, uint8_t databyte)
 	I2Cx->I2DAT = databyte & I2C_I2DAT_BITMASK;
 	I2Cx->I2CONCLR = I2C_I2CONCLR_SIC;
 
-	while (!(I2Cx->I2CONSET & I2C_I2CONSET_SI));
+	if (!I2C_WaitSI(I2Cx)){
+		return (I2C_SETUP_STATUS_TIMEOUT);
+	}
 	return (I2Cx->I2STAT & I2C_STAT_CODE_BITMASK);
 }
 
@@ -178,7 +226,8 @@ static uint32_t I2C_SendByte (LPC_I2C_TypeDef *I2Cx, uint8_t databyte)
  * Purpose: Get a byte
  * Parameters:
  *     I2Cx: Pointer to I2C register
- * Returns: value of I2C status register after receiving
+ * Returns: value of I2C status register after receiving,
+ *          or I2C_SETUP_STATUS_TIMEOUT if SI was not set in time
  **********************************************************************/
 static uint32_t I2C_GetByte (LPC_I2C_TypeDef *I2Cx, uint8_t *retdat, Bool ack)
 {
@@ -192,12 +241,52 @@ static uint32_t I2C_GetByte (LPC_I2C_TypeDef *I2Cx, uint8_t *retdat, Bool ack)
 	}
 	I2Cx->I2CONCLR = I2C_I2CONCLR_SIC;
 
-	while (!(I2Cx->I2CONSET & I2C_I2CONSET_SI));
+	if (!I2C_WaitSI(I2Cx)){
+		return (I2C_SETUP_STATUS_TIMEOUT);
+	}
 	*retdat = (uint8_t) (I2Cx->I2DAT & I2C_I2DAT_BITMASK);
 	return (I2Cx->I2STAT & I2C_STAT_CODE_BITMASK);
 }
 
 
+/***********************************************************************
+ * Function: I2C_WaitSI
+ * Purpose: Wait for the SI flag, bounded by the master time-out
+ * Parameters:
+ *     I2Cx: Pointer to I2C register
+ * Returns: TRUE if SI has been set, FALSE if the deadline passed
+ **********************************************************************/
+static Bool I2C_WaitSI (LPC_I2C_TypeDef *I2Cx)
+{
+	uint32_t start = I2C_DWT_CYCCNT;
+
+	while (!(I2Cx->I2CONSET & I2C_I2CONSET_SI))
+	{
+		// Unsigned difference is safe across counter wrap-around
+		if ((I2C_DWT_CYCCNT - start) > i2ctimeout)
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+
+/***********************************************************************
+ * Function: I2C_Delay
+ * Purpose: Busy wait for a number of core cycles
+ * Parameters:
+ *     cycles: number of core cycles to wait
+ * Returns: None
+ **********************************************************************/
+static void I2C_Delay (uint32_t cycles)
+{
+	uint32_t start = I2C_DWT_CYCCNT;
+
+	while ((I2C_DWT_CYCCNT - start) < cycles);
+}
+
+
 
 /*********************************************************************//**
  * @brief 		Enable/Disable interrupt for I2C peripheral
@@ -712,6 +801,11 @@ void I2C_Init(LPC_I2C_TypeDef *I2Cx, uint32_t clockrate)
 		return;
 	}
 
+    /* Enable the core cycle counter used for polling time-outs */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    I2C_DWT_CTRL |= I2C_DWT_CTRL_CYCCNTENA;
+    i2ctimeout = (SystemCoreClock / 1000000) * I2C_MASTER_TIME_OUT_US;
+
     /* Set clock rate */
     I2C_SetClock(I2Cx, clockrate);
     /* Set I2C operation to default */
@@ -752,6 +846,10 @@ void I2C_Cmd(LPC_I2C_TypeDef* I2Cx, FunctionalState NewState)
  * @return 		SUCCESS or ERROR
  *
  * Note:
+ * - In polling mode every wait for the SI flag is bounded by
+ * I2C_MASTER_TIME_OUT_US. On time-out the bus is recovered with
+ * I2C_BusRecovery(), ERROR is returned and I2C_SETUP_STATUS_TIMEOUT
+ * is set in the status field.
  * - In case of using I2C to transmit data only, either transmit length set to 0
  * or transmit data pointer set to NULL.
  * - In case of using I2C to receive data only, either receive length set to 0
@@ -778,6 +876,8 @@ Status I2C_MasterTransferData(LPC_I2C_TypeDef *I2Cx, I2C_M_SETUP_Type *TransferC
 
 	if (Opt == I2C_TRANSFER_POLLING){
 
+		i2cbusy[I2C_getNum(I2Cx)] = 1;
+
 		/* First Start condition -------------------------------------------------------------- */
 		TransferCfg->retransmissions_count = 0;
 retry:
@@ -791,6 +891,9 @@ retry:
 
 		// Start command
 		CodeStatus = I2C_Start(I2Cx);
+		if (CodeStatus == I2C_SETUP_STATUS_TIMEOUT){
+			goto timeout;
+		}
 		if ((CodeStatus != I2C_I2STAT_M_TX_START) \
 				&& (CodeStatus != I2C_I2STAT_M_TX_RESTART)){
 			TransferCfg->retransmissions_count++;
@@ -808,6 +911,9 @@ retry:
 
 			/* Send slave address + WR direction bit = 0 ----------------------------------- */
 			CodeStatus = I2C_SendByte(I2Cx, (TransferCfg->sl_addr7bit << 1));
+			if (CodeStatus == I2C_SETUP_STATUS_TIMEOUT){
+				goto timeout;
+			}
 			if (CodeStatus != I2C_I2STAT_M_TX_SLAW_ACK){
 				TransferCfg->retransmissions_count++;
 				if (TransferCfg->retransmissions_count > TransferCfg->retransmissions_max){
@@ -823,6 +929,9 @@ retry:
 			while (TransferCfg->tx_count < TransferCfg->tx_length)
 			{
 				CodeStatus = I2C_SendByte(I2Cx, *txdat);
+				if (CodeStatus == I2C_SETUP_STATUS_TIMEOUT){
+					goto timeout;
+				}
 				if (CodeStatus != I2C_I2STAT_M_TX_DAT_ACK){
 					TransferCfg->retransmissions_count++;
 					if (TransferCfg->retransmissions_count > TransferCfg->retransmissions_max){
@@ -844,6 +953,9 @@ retry:
 				&& (TransferCfg->rx_length != 0) && (TransferCfg->rx_data != NULL)){
 
 			CodeStatus = I2C_Start(I2Cx);
+			if (CodeStatus == I2C_SETUP_STATUS_TIMEOUT){
+				goto timeout;
+			}
 			if ((CodeStatus != I2C_I2STAT_M_RX_START) \
 					&& (CodeStatus != I2C_I2STAT_M_RX_RESTART)){
 				TransferCfg->retransmissions_count++;
@@ -862,6 +974,9 @@ retry:
 			/* Send slave address + RD direction bit = 1 ----------------------------------- */
 
 			CodeStatus = I2C_SendByte(I2Cx, ((TransferCfg->sl_addr7bit << 1) | 0x01));
+			if (CodeStatus == I2C_SETUP_STATUS_TIMEOUT){
+				goto timeout;
+			}
 			if (CodeStatus != I2C_I2STAT_M_RX_SLAR_ACK){
 				TransferCfg->retransmissions_count++;
 				if (TransferCfg->retransmissions_count > TransferCfg->retransmissions_max){
@@ -884,6 +999,9 @@ retry:
 				if (TransferCfg->rx_count < (TransferCfg->rx_length - 1)){
 					// Issue an ACK signal for next data frame
 					CodeStatus = I2C_GetByte(I2Cx, &tmp, 1);
+					if (CodeStatus == I2C_SETUP_STATUS_TIMEOUT){
+						goto timeout;
+					}
 					if (CodeStatus != I2C_I2STAT_M_RX_DAT_ACK){
 						TransferCfg->retransmissions_count++;
 						if (TransferCfg->retransmissions_count > TransferCfg->retransmissions_max){
@@ -897,6 +1015,9 @@ retry:
 				} else {
 					// Do not issue an ACK signal
 					CodeStatus = I2C_GetByte(I2Cx, &tmp, 0);
+					if (CodeStatus == I2C_SETUP_STATUS_TIMEOUT){
+						goto timeout;
+					}
 					if (CodeStatus != I2C_I2STAT_M_RX_DAT_NACK){
 						TransferCfg->retransmissions_count++;
 						if (TransferCfg->retransmissions_count > TransferCfg->retransmissions_max){
@@ -915,11 +1036,20 @@ retry:
 
 		/* Send STOP condition ------------------------------------------------- */
 		I2C_Stop(I2Cx);
+		i2cbusy[I2C_getNum(I2Cx)] = 0;
 		return SUCCESS;
 
 error:
 		// Send stop condition
 		I2C_Stop(I2Cx);
+		i2cbusy[I2C_getNum(I2Cx)] = 0;
+		return ERROR;
+
+timeout:
+		// SI never came back, free the bus before reporting the failure
+		TransferCfg->status = I2C_SETUP_STATUS_TIMEOUT;
+		I2C_BusRecovery(I2Cx);
+		i2cbusy[I2C_getNum(I2Cx)] = 0;
 		return ERROR;
 	}
 
@@ -1151,6 +1281,112 @@ s_error:
 	return ERROR;
 }
 
+/*********************************************************************//**
+ * @brief		Set the pins used by I2C_BusRecovery() for I2C peripheral
+ * @param[in]	I2Cx	I2C peripheral selected, should be I2C0, I2C1 or I2C2
+ * @param[in]	RecoveryCfg	Pointer to a I2C_RECOVERY_CFG_Type structure
+ * 				that contains the SCL/SDA pins and the I2C pin function
+ * @return 		None
+ *
+ * Note: only needed when the peripheral is routed to pins other than
+ * the defaults P0.27/P0.28 (I2C0), P0.19/P0.20 (I2C1), P0.10/P0.11 (I2C2)
+ **********************************************************************/
+void I2C_SetRecoveryPins(LPC_I2C_TypeDef *I2Cx, I2C_RECOVERY_CFG_Type *RecoveryCfg)
+{
+	int32_t tmp;
+
+	CHECK_PARAM(PARAM_I2Cx(I2Cx));
+
+	tmp = I2C_getNum(I2Cx);
+	i2crecovery[tmp] = *RecoveryCfg;
+}
+
+
+/*********************************************************************//**
+ * @brief		Check whether a polling master transfer is in progress
+ * @param[in]	I2Cx	I2C peripheral selected, should be I2C0, I2C1 or I2C2
+ * @return 		SET while I2C_MasterTransferData() is running in polling
+ * 				mode on I2Cx, otherwise RESET
+ *
+ * Note: a transfer started from an interrupt handler would corrupt a
+ * polling transfer it preempted. Such a handler checks this first and
+ * defers its transfer while it returns SET.
+ **********************************************************************/
+FlagStatus I2C_MasterIsBusy(LPC_I2C_TypeDef *I2Cx)
+{
+	CHECK_PARAM(PARAM_I2Cx(I2Cx));
+
+	return (i2cbusy[I2C_getNum(I2Cx)] ? SET : RESET);
+}
+
+
+/*********************************************************************//**
+ * @brief		Recover a stuck I2C bus
+ * @param[in]	I2Cx	I2C peripheral selected, should be I2C0, I2C1 or I2C2
+ * @return 		None
+ *
+ * Note:
+ * The controller is disabled and SCL/SDA are driven as GPIO. SCL is
+ * clocked up to I2C_RECOVERY_SCL_PULSES times until the slave releases
+ * SDA, then a STOP condition is generated by hand. Afterwards the pins
+ * are handed back to the controller and it is enabled again.
+ * Lines are released by switching them to input (external pull-ups),
+ * and pulled low by switching them to output with a low level.
+ **********************************************************************/
+void I2C_BusRecovery(LPC_I2C_TypeDef *I2Cx)
+{
+	I2C_RECOVERY_CFG_Type *cfg;
+	uint32_t scl, sda;
+	uint32_t halfperiod;
+	int32_t i;
+
+	CHECK_PARAM(PARAM_I2Cx(I2Cx));
+
+	cfg = &i2crecovery[I2C_getNum(I2Cx)];
+	scl = 1 << cfg->SclPinnum;
+	sda = 1 << cfg->SdaPinnum;
+	// Half period of a 100kHz clock
+	halfperiod = SystemCoreClock / 200000;
+
+	/* Take the pins away from the controller */
+	I2Cx->I2CONCLR = I2C_I2CONCLR_I2ENC;
+	LPC_GPIO0->FIOCLR = scl | sda;
+	LPC_GPIO0->FIODIR &= ~(scl | sda);
+	PINSEL_SetPinFunc(0, cfg->SclPinnum, 0);
+	PINSEL_SetPinFunc(0, cfg->SdaPinnum, 0);
+	I2C_Delay(halfperiod);
+
+	/* Clock out whatever the slave is still trying to send */
+	for (i = 0; i < I2C_RECOVERY_SCL_PULSES; i++)
+	{
+		if (LPC_GPIO0->FIOPIN & sda)
+		{
+			break;
+		}
+		LPC_GPIO0->FIODIR |= scl;
+		I2C_Delay(halfperiod);
+		LPC_GPIO0->FIODIR &= ~scl;
+		I2C_Delay(halfperiod);
+	}
+
+	/* STOP condition: SDA rises while SCL is high */
+	LPC_GPIO0->FIODIR |= scl;
+	I2C_Delay(halfperiod);
+	LPC_GPIO0->FIODIR |= sda;
+	I2C_Delay(halfperiod);
+	LPC_GPIO0->FIODIR &= ~scl;
+	I2C_Delay(halfperiod);
+	LPC_GPIO0->FIODIR &= ~sda;
+	I2C_Delay(halfperiod);
+
+	/* Give the pins back and restart the controller */
+	PINSEL_SetPinFunc(0, cfg->SclPinnum, cfg->Funcnum);
+	PINSEL_SetPinFunc(0, cfg->SdaPinnum, cfg->Funcnum);
+	I2Cx->I2CONCLR = I2C_I2CONCLR_AAC | I2C_I2CONCLR_SIC | I2C_I2CONCLR_STAC;
+	I2Cx->I2CONSET = I2C_I2CONSET_I2EN;
+}
+
+
 /*********************************************************************//**
  * @brief		Set Own slave address in I2C peripheral corresponding to
  * 				parameter specified in OwnSlaveAddrConfigStruct.
@@ -54,6 +54,17 @@ typedef struct {
 	fnErrCbs_Type *pfnErrCbs;	// Error callback
 } UART_CBS_Type;
 
+/**
+ * @brief UART divisor setting for one PCLK and baud rate
+ */
+typedef struct {
+	uint32_t pclk;			// UART peripheral clock in Hz
+	uint32_t baudrate;		// Baud rate
+	uint16_t diviser;		// DLM:DLL value
+	uint8_t dividerAdd;		// FDR DIVADDVAL
+	uint8_t mulFracDiv;		// FDR MULVAL
+} UART_DIVISOR_Type;
+
 /**
  * @}
  */
@@ -76,6 +87,37 @@ UART_CBS_Type uartCbsDat[4] = {
 /** UART1 modem status interrupt callback pointer data */
 fnModemCbs_Type *pfnModemCbs = NULL;
 
+/**
+ * Precomputed divisor settings for the PCLK values a 100 MHz CCLK gives
+ * (CCLK/1, /2, /4). Each entry is the closest setting with
+ * DIVADDVAL < MULVAL and DLL >= 3 when DIVADDVAL > 0. The comment gives
+ * the error of the actual rate. 921600 and 1000000 are out of the
+ * accepted error at 25 MHz, and 1000000 at 50 MHz. Other combinations
+ * fall back to the search in uart_set_divisors().
+ */
+static const UART_DIVISOR_Type uartDivisorTable[] = {
+		{100000000,    9600, 514,  4, 15},	// -0.004%
+		{100000000,   19200, 257,  4, 15},	// -0.004%
+		{100000000,   38400,  92, 10, 13},	// -0.005%
+		{100000000,   57600,  93,  1,  6},	// +0.006%
+		{100000000,  115200,  31,  3,  4},	// +0.006%
+		{100000000,  230400,  19,  3,  7},	// -0.059%
+		{100000000,  460800,  10,  5, 14},	// -0.059%
+		{100000000,  921600,   5,  5, 14},	// -0.059%
+		{100000000, 1000000,   5,  1,  4},	//  0.000%
+		{ 50000000,  115200,  19,  3,  7},	// -0.059%
+		{ 50000000,  230400,  10,  5, 14},	// -0.059%
+		{ 50000000,  460800,   5,  5, 14},	// -0.059%
+		{ 50000000,  921600,   3,  2, 15},	// -0.269%
+		{ 25000000,    9600,  92, 10, 13},	// -0.005%
+		{ 25000000,   19200,  46, 10, 13},	// -0.005%
+		{ 25000000,   38400,  23, 10, 13},	// -0.005%
+		{ 25000000,   57600,  19,  3,  7},	// -0.059%
+		{ 25000000,  115200,  10,  5, 14},	// -0.059%
+		{ 25000000,  230400,   5,  5, 14},	// -0.059%
+		{ 25000000,  460800,   3,  2, 15},	// -0.269%
+};
+
 /**
  * @}
  */
@@ -98,12 +140,34 @@ uint8_t getUartNum(LPC_UART_TypeDef *UARTx) {
 	else return (3);
 }
 
+/*********************************************************************//**
+ * @brief		Look up precomputed dividers for a PCLK and baud rate
+ * @param[in]	pclk		UART peripheral clock in Hz
+ * @param[in]	baudrate	Desired UART baud rate
+ * @return 		Matching table entry, or NULL if there is none
+ **********************************************************************/
+static const UART_DIVISOR_Type *uart_find_divisors(uint32_t pclk, uint32_t baudrate)
+{
+	uint32_t i;
+
+	for (i = 0; i < sizeof(uartDivisorTable) / sizeof(uartDivisorTable[0]); i++)
+	{
+		if ((uartDivisorTable[i].pclk == pclk) && (uartDivisorTable[i].baudrate == baudrate))
+		{
+			return &uartDivisorTable[i];
+		}
+	}
+	return NULL;
+}
+
 /*********************************************************************//**
  * @brief		Determines best dividers to get a target clock rate
  * @param[in]	UARTx	Pointer to selected UART peripheral, should be
  * 						UART0, UART1, UART2 or UART3.
  * @param[in]	baudrate Desired UART baud rate.
  * @return 		Error status.
+ * Note:		Common rates are taken from uartDivisorTable, others are
+ * 				found by searching all fractional divider settings.
  **********************************************************************/
 
 Status uart_set_divisors(LPC_UART_TypeDef *UARTx, uint32_t baudrate)
@@ -123,6 +187,8 @@ Status uart_set_divisors(LPC_UART_TypeDef *UARTx, uint32_t baudrate)
 	uint32_t relativeError = 0;
 	uint32_t relativeOptimalError = 100000;
 
+	const UART_DIVISOR_Type *preset;
+
 	/* get UART block clock */
 	if (UARTx == (LPC_UART_TypeDef*) LPC_UART0)
 	{
@@ -141,7 +207,16 @@ Status uart_set_divisors(LPC_UART_TypeDef *UARTx, uint32_t baudrate)
 		uClk = CLKPWR_GetPCLK (CLKPWR_PCLKSEL_UART3);
 	}
 
-
+	preset = uart_find_divisors(uClk, baudrate);
+	if (preset != NULL)
+	{
+		mulFracDivOptimal = preset->mulFracDiv;
+		dividerAddOptimal = preset->dividerAdd;
+		diviserOptimal = preset->diviser;
+		relativeOptimalError = 0;
+	}
+	else
+	{
 	uClk = uClk >> 4; /* div by 16 */
 	/* In the Uart IP block, baud rate is calculated using FDR and DLL-DLM registers
 	* The formula is :
@@ -149,10 +224,10 @@ Status uart_set_divisors(LPC_UART_TypeDef *UARTx, uint32_t baudrate)
 	* It involves floating point calculations. That's the reason the formulae are adjusted with
 	* Multiply and divide method.*/
 	/* The value of mulFracDiv and dividerAddFracDiv should comply to the following expressions:
-	* 0 < mulFracDiv <= 15, 0 <= dividerAddFracDiv <= 15 */
+	* 0 < mulFracDiv <= 15, 0 <= dividerAddFracDiv < mulFracDiv */
 	for (mulFracDiv = 1 ; mulFracDiv <= 15 ;mulFracDiv++)
 	{
-	for (dividerAddFracDiv = 0 ; dividerAddFracDiv <= 15 ;dividerAddFracDiv++)
+	for (dividerAddFracDiv = 0 ; dividerAddFracDiv < mulFracDiv ;dividerAddFracDiv++)
 	{
 	  temp = (mulFracDiv * uClk) / ((mulFracDiv + dividerAddFracDiv));
 
@@ -183,6 +258,7 @@ Status uart_set_divisors(LPC_UART_TypeDef *UARTx, uint32_t baudrate)
 	if (relativeError == 0)
 	  break;
 	} /* end of outer for loop  */
+	} /* end of search */
 
 	if (relativeOptimalError < ((baudrate * UART_ACCEPTED_BAUDRATE_ERROR)/100))
 	{
@@ -212,6 +288,28 @@ Status uart_set_divisors(LPC_UART_TypeDef *UARTx, uint32_t baudrate)
 	return errorStatus;
 }
 
+/*********************************************************************//**
+ * @brief		Change the baud rate of an initialized UART
+ * @param[in]	UARTx	UART peripheral selected, should be UART0, UART1,
+ * 						UART2 or UART3.
+ * @param[in]	baudrate New baud rate
+ * @return 		SUCCESS, or ERROR if the rate cannot be reached within
+ * 				UART_ACCEPTED_BAUDRATE_ERROR with the current PCLK. The
+ * 				old rate is kept on ERROR.
+ * Note:		Waits until the transmitter is empty so no character is
+ * 				sent at a mix of both rates. The UART interrupt must be
+ * 				disabled by the caller, since DLL and DLM share their
+ * 				addresses with RBR/THR and IER while DLAB is set.
+ **********************************************************************/
+Status UART_SetBaudrate(LPC_UART_TypeDef *UARTx, uint32_t baudrate)
+{
+	CHECK_PARAM(PARAM_UARTx(UARTx));
+
+	while (!(UARTx->LSR & UART_LSR_TEMT));
+
+	return uart_set_divisors(UARTx, baudrate);
+}
+
 /*********************************************************************//**
  * @brief		General UART interrupt handler and router
  * @param[in]	UARTx	Selected UART peripheral, should be UART0..3
@@ -0,0 +1,231 @@
+/*****************************************************************************
+ *   motion_replay.c:  Run recorded accelerometer traces through the
+ *                     movement detector on the host
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * Reads a trace (file argument or stdin) with one sample per line:
+ *
+ *   x,y,z,moving
+ *
+ * x, y and z are in 1/64 g (counts of the 2g output) at 125 Hz, moving
+ * is 1 where the board was really moved and 0 where it was at rest. Other
+ * lines, e.g. a CSV header or a # comment, are skipped. The samples go
+ * through Assignment2/src/motion.c and the detections are compared with
+ * the labels:
+ *
+ *   missed       - movements with no detection during them or within one
+ *                  window after
+ *   false alarms - detections that do not overlap a movement or the
+ *                  window after one
+ *
+ * With -v every sample is also printed with its energy and detection.
+ *
+ * Build on the host:
+ *   cc -std=c99 -O2 -I../Assignment2/src -I../Lib_MCU/inc \
+ *      -I../Lib_EaBaseBoard/inc -o motion_replay motion_replay.c \
+ *      ../Assignment2/src/motion.c
+ * Usage:
+ *   motion_replay [-v] [-on level] [-off level] [trace.csv]
+ *
+ * The exit status is 0 with no missed movement and no false alarm, 2
+ * otherwise. The labelled traces in traces/ are checked with the default
+ * levels, in tools/:
+ *   for t in $(ls traces); do
+ *       ./motion_replay traces/$t || echo "$t FAILED"
+ *   done
+ *
+ * traces/desk_rest_move.csv is synthetic: 50 s on a desk with noise,
+ * table vibration and a slow drift at rest, and as movements two shakes,
+ * two tilts and a knock.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "motion.h"
+
+/******************************************************************************
+ * Defines and typedefs
+ *****************************************************************************/
+
+typedef struct
+{
+    acc_sample_t s;
+    uint8_t moving;     /* label */
+    uint8_t detected;
+} record_t;
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+static record_t *readTrace (FILE *in, unsigned long *count)
+{
+    record_t *recs = NULL;
+    unsigned long n = 0;
+    unsigned long max = 0;
+    char line[128];
+    int x, y, z, m;
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (sscanf(line, "%d,%d,%d,%d", &x, &y, &z, &m) != 4)
+            continue;
+
+        if (n == max) {
+            max = (max == 0) ? 1024 : max * 2;
+            recs = realloc(recs, max * sizeof(*recs));
+            if (recs == NULL) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+
+        recs[n].s.x = (int8_t)x;
+        recs[n].s.y = (int8_t)y;
+        recs[n].s.z = (int8_t)z;
+        recs[n].s.pad = 0;
+        recs[n].moving = (m != 0);
+        recs[n].detected = 0;
+        n++;
+    }
+
+    *count = n;
+    return recs;
+}
+
+/* 1 if sample i is labelled moving or within one window after that */
+static int nearMovement (const record_t *recs, unsigned long i)
+{
+    unsigned long j = (i >= MOTION_WINDOW) ? i - MOTION_WINDOW : 0;
+
+    for (; j <= i; j++) {
+        if (recs[j].moving)
+            return 1;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+
+int main (int argc, char *argv[])
+{
+    FILE *in = stdin;
+    motion_state_t st;
+    uint32_t onLevel = MOTION_ON_LEVEL;
+    uint32_t offLevel = MOTION_OFF_LEVEL;
+    int verbose = 0;
+    record_t *recs;
+    unsigned long n;
+    unsigned long i, j, end;
+    unsigned long movements = 0;
+    unsigned long missed = 0;
+    unsigned long detections = 0;
+    unsigned long falseAlarms = 0;
+    int hit;
+
+    while (argc > 1 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-v") == 0) {
+            verbose = 1;
+        } else if (strcmp(argv[1], "-on") == 0 && argc > 2) {
+            onLevel = (uint32_t)strtoul(argv[2], NULL, 0);
+            argc--;
+            argv++;
+        } else if (strcmp(argv[1], "-off") == 0 && argc > 2) {
+            offLevel = (uint32_t)strtoul(argv[2], NULL, 0);
+            argc--;
+            argv++;
+        } else {
+            fprintf(stderr, "usage: motion_replay [-v] [-on level] "
+                    "[-off level] [trace.csv]\n");
+            return 1;
+        }
+        argc--;
+        argv++;
+    }
+
+    if (argc > 1) {
+        in = fopen(argv[1], "r");
+        if (in == NULL) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    recs = readTrace(in, &n);
+
+    if (in != stdin)
+        fclose(in);
+
+    motion_init(&st, onLevel, offLevel);
+
+    if (verbose)
+        printf("sample,x,y,z,moving,energy,detected\n");
+
+    for (i = 0; i < n; i++) {
+        recs[i].detected = (motion_process(&st, &recs[i].s, 1) != 0);
+        if (verbose)
+            printf("%lu,%d,%d,%d,%u,%u,%u\n", i,
+                    recs[i].s.x, recs[i].s.y, recs[i].s.z,
+                    (unsigned)recs[i].moving,
+                    (unsigned)motion_getEnergy(&st),
+                    (unsigned)recs[i].detected);
+    }
+
+    /* movements, each must be detected by one window after it ends */
+    for (i = 0; i < n; i = end) {
+        if (!recs[i].moving) {
+            end = i + 1;
+            continue;
+        }
+        for (end = i; end < n && recs[end].moving; end++)
+            ;
+        movements++;
+        hit = 0;
+        for (j = i; j < n && j < end + MOTION_WINDOW; j++) {
+            if (recs[j].detected) {
+                hit = 1;
+                break;
+            }
+        }
+        if (!hit)
+            missed++;
+    }
+
+    /* detections, each must overlap a movement */
+    for (i = 0; i < n; i = end) {
+        if (!recs[i].detected) {
+            end = i + 1;
+            continue;
+        }
+        detections++;
+        hit = 0;
+        for (end = i; end < n && recs[end].detected; end++) {
+            if (nearMovement(recs, end))
+                hit = 1;
+        }
+        if (!hit)
+            falseAlarms++;
+    }
+
+    fprintf(stderr, "%lu samples, %lu movements, %lu missed, "
+            "%lu detections, %lu false alarms\n",
+            n, movements, missed, detections, falseAlarms);
+
+    free(recs);
+
+    return (missed == 0 && falseAlarms == 0) ? 0 : 2;
+}
@@ -0,0 +1,398 @@
+/*****************************************************************************
+ *   telemetry_decode.c:  Host decoder for the binary UART telemetry
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * Reads a captured byte stream (file argument or stdin) and writes one
+ * CSV line per valid frame to stdout. Frames with a bad length or CRC
+ * are counted and reported on stderr. The frame layout is described in
+ * Assignment2/src/telemetry.h.
+ *
+ * Samples that are not in the output are counted as lost: gaps in the
+ * seq, which includes the bad frames, and with -d the records skipped.
+ *
+ * With -d the stream is the delta compressed format ("set format delta").
+ * After a bad or missing record, seen by a jump of its seq byte, the
+ * deltas are skipped until the next keyframe.
+ *
+ * Build on the host:  cc -std=c99 -O2 -o telemetry_decode telemetry_decode.c
+ * Usage:              telemetry_decode [-d] [capture.bin]
+ *
+ * telemetry_test.c checks the round trip from Assignment2/src/telemetry.c
+ * through this decoder.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/******************************************************************************
+ * Defines and typedefs
+ *****************************************************************************/
+
+#define SAMPLE_LEN  14
+#define FRAME_LEN   (SAMPLE_LEN + 2)
+
+/* Longest encoded frame kept, anything longer is garbage */
+#define MAX_ENCODED 64
+
+/* Largest delta record payload plus CRC */
+#define DELTA_MAX   (28 + 2)
+
+#define DELTA_KEY   0x80
+#define DELTA_TIME  0x02
+#define DELTA_TEMP  0x04
+#define DELTA_LIGHT 0x08
+#define DELTA_ACC   0x10
+#define DELTA_WARN  0x20
+
+typedef struct
+{
+    uint32_t seq;
+    uint32_t time;
+    int32_t temp;
+    uint32_t light;
+    int32_t x;
+    int32_t y;
+    int32_t z;
+    uint32_t warnings;
+} sample_t;
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+/* Delta decoder state, valid once a keyframe has been seen */
+static sample_t prev;
+static uint32_t prevInterval;
+static int haveKey = 0;
+
+/* seq of the next sample, valid once a sample has been placed */
+static uint32_t nextSeq;
+static int haveSeq = 0;
+static unsigned long lost = 0;
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+static uint16_t crc16 (const uint8_t *data, uint32_t len)
+{
+    uint16_t crc = 0xFFFF;
+    int i;
+
+    while (len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+
+    return crc;
+}
+
+/* Returns the decoded length or -1 if the block is not valid COBS */
+static int cobsDecode (const uint8_t *in, int len, uint8_t *out, int max)
+{
+    int i = 0;
+    int o = 0;
+
+    while (i < len) {
+        int code = in[i++];
+        int j;
+
+        if (code == 0 || i + code - 1 > len)
+            return -1;
+
+        for (j = 1; j < code; j++) {
+            if (o >= max)
+                return -1;
+            out[o++] = in[i++];
+        }
+
+        if (code != 0xFF && i < len) {
+            if (o >= max)
+                return -1;
+            out[o++] = 0;
+        }
+    }
+
+    return o;
+}
+
+static uint32_t get16 (const uint8_t *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8);
+}
+
+static uint32_t get32 (const uint8_t *p)
+{
+    return get16(p) | (get16(p + 2) << 16);
+}
+
+/* Read a varint at *pos, returns -1 if it runs past len */
+static int getVarint (const uint8_t *p, int len, int *pos, uint32_t *v)
+{
+    int shift = 0;
+
+    *v = 0;
+    while (*pos < len && shift < 35) {
+        uint8_t b = p[(*pos)++];
+        *v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return 0;
+        shift += 7;
+    }
+
+    return -1;
+}
+
+static int32_t unzigzag (uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static int getSigned (const uint8_t *p, int len, int *pos, int32_t *v)
+{
+    uint32_t u;
+
+    if (getVarint(p, len, pos, &u) != 0)
+        return -1;
+    *v = unzigzag(u);
+
+    return 0;
+}
+
+/* Count the samples skipped before this seq, returns the number */
+static uint32_t takeSeq (uint32_t seq)
+{
+    uint32_t gap = 0;
+
+    if (haveSeq)
+        gap = (seq - nextSeq) & 0xFFFF;
+    lost += gap;
+    nextSeq = (seq + 1) & 0xFFFF;
+    haveSeq = 1;
+
+    return gap;
+}
+
+static void printSample (const sample_t *s)
+{
+    int32_t t = s->temp;
+
+    printf("%u,%u,%s%d.%d,%u,%d,%d,%d,%u,%u\n",
+            (unsigned)s->seq,
+            (unsigned)s->time,
+            (t < 0) ? "-" : "",
+            (t < 0 ? -t : t) / 10,
+            (t < 0 ? -t : t) % 10,
+            (unsigned)s->light,
+            (int)s->x, (int)s->y, (int)s->z,
+            (unsigned)(s->warnings & 0x01),
+            (unsigned)((s->warnings >> 1) & 0x01));
+}
+
+/* Returns 0 if a line was printed */
+static int decodeFrame (const uint8_t *enc, int len)
+{
+    uint8_t raw[FRAME_LEN];
+    sample_t s;
+
+    if (cobsDecode(enc, len, raw, sizeof(raw)) != FRAME_LEN)
+        return -1;
+
+    if (crc16(raw, SAMPLE_LEN) != get16(&raw[SAMPLE_LEN]))
+        return -1;
+
+    s.seq = get16(&raw[0]);
+    s.time = get32(&raw[2]);
+    s.temp = (int16_t)get16(&raw[6]);
+    s.light = get16(&raw[8]);
+    s.x = (int8_t)raw[10];
+    s.y = (int8_t)raw[11];
+    s.z = (int8_t)raw[12];
+    s.warnings = raw[13];
+    takeSeq(s.seq);
+    printSample(&s);
+
+    return 0;
+}
+
+/* Returns 0 if a line was printed, 1 if the record was skipped */
+static int decodeDelta (const uint8_t *enc, int len)
+{
+    uint8_t raw[DELTA_MAX];
+    int n;
+    int pos = 1;
+    uint8_t hdr;
+    sample_t s;
+    uint32_t seq;
+    uint32_t u;
+    int32_t d;
+    uint32_t interval;
+
+    n = cobsDecode(enc, len, raw, sizeof(raw));
+    if (n < 3 || crc16(raw, n - 2) != get16(&raw[n - 2])) {
+        haveKey = 0;
+        return -1;
+    }
+    n -= 2;
+    hdr = raw[0];
+
+    if (hdr & DELTA_KEY) {
+        if (getVarint(raw, n, &pos, &s.seq) != 0
+                || getVarint(raw, n, &pos, &s.time) != 0
+                || getSigned(raw, n, &pos, &s.temp) != 0
+                || getVarint(raw, n, &pos, &s.light) != 0
+                || getSigned(raw, n, &pos, &s.x) != 0
+                || getSigned(raw, n, &pos, &s.y) != 0
+                || getSigned(raw, n, &pos, &s.z) != 0
+                || pos >= n) {
+            haveKey = 0;
+            return -1;
+        }
+        s.warnings = raw[pos++];
+        interval = 0;
+        takeSeq(s.seq);
+        haveKey = 1;
+    } else {
+        if (pos >= n)
+            goto bad;
+
+        /* the seq byte places the record, a jump means records were missed */
+        if (!haveSeq) {
+            lost++;
+            return 1;
+        }
+        seq = (nextSeq + ((raw[pos++] - nextSeq) & 0xFF)) & 0xFFFF;
+        if (takeSeq(seq) != 0 || !haveKey) {
+            haveKey = 0;
+            lost++;
+            return 1;
+        }
+        s = prev;
+        s.seq = seq;
+
+        d = 0;
+        if ((hdr & DELTA_TIME) && getSigned(raw, n, &pos, &d) != 0)
+            goto bad;
+        interval = prevInterval + d;
+        s.time = prev.time + interval;
+
+        if ((hdr & DELTA_TEMP) && getSigned(raw, n, &pos, &d) == 0)
+            s.temp = (int16_t)(prev.temp + d);
+        else if (hdr & DELTA_TEMP)
+            goto bad;
+
+        if (hdr & DELTA_LIGHT) {
+            if (getVarint(raw, n, &pos, &u) != 0)
+                goto bad;
+            s.light = prev.light + (uint32_t)unzigzag(u);
+        }
+
+        if (hdr & DELTA_ACC) {
+            if (getSigned(raw, n, &pos, &d) != 0)
+                goto bad;
+            s.x = (int8_t)(prev.x + d);
+            if (getSigned(raw, n, &pos, &d) != 0)
+                goto bad;
+            s.y = (int8_t)(prev.y + d);
+            if (getSigned(raw, n, &pos, &d) != 0)
+                goto bad;
+            s.z = (int8_t)(prev.z + d);
+        }
+
+        if (hdr & DELTA_WARN) {
+            if (pos >= n)
+                goto bad;
+            s.warnings = raw[pos++];
+        }
+    }
+
+    prev = s;
+    prevInterval = interval;
+    printSample(&s);
+
+    return 0;
+
+bad:
+    haveKey = 0;
+    return -1;
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+
+int main (int argc, char *argv[])
+{
+    FILE *in = stdin;
+    int delta = 0;
+    int r;
+    uint8_t enc[MAX_ENCODED];
+    int len = 0;
+    int overflow = 0;
+    unsigned long good = 0;
+    unsigned long bad = 0;
+    int c;
+
+    if (argc > 1 && strcmp(argv[1], "-d") == 0) {
+        delta = 1;
+        argc--;
+        argv++;
+    }
+
+    if (argc > 1) {
+        in = fopen(argv[1], "rb");
+        if (in == NULL) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    printf("seq,time_ms,temp_c,light_lux,x,y,z,high_temp,movement\n");
+
+    while ((c = fgetc(in)) != EOF) {
+        if (c != 0) {
+            if (len < MAX_ENCODED)
+                enc[len++] = (uint8_t)c;
+            else
+                overflow = 1;
+            continue;
+        }
+
+        /* delimiter, an empty block is just a resync */
+        if (len > 0 || overflow) {
+            if (overflow)
+                r = -1;
+            else if (delta)
+                r = decodeDelta(enc, len);
+            else
+                r = decodeFrame(enc, len);
+
+            if (r == 0)
+                good++;
+            else if (r < 0)
+                bad++;
+        }
+        len = 0;
+        overflow = 0;
+    }
+
+    /* a trailing partial frame is not counted */
+
+    if (in != stdin)
+        fclose(in);
+
+    fprintf(stderr, "%lu frames, %lu bad, %lu lost\n", good, bad, lost);
+
+    return (bad == 0 && lost == 0) ? 0 : 2;
+}
@@ -0,0 +1,273 @@
+/*****************************************************************************
+ *   telemetry_test.c:  Round trip check of the binary telemetry through
+ *                      the host decoder
+ *
+ *   Copyright(C) 2011, EE2024
+ *   All rights reserved.
+ *
+ ******************************************************************************/
+
+/*
+ * Samples are framed with Assignment2/src/telemetry.c, fixed or delta,
+ * written to a capture file and run through telemetry_decode. A case may
+ * leave one frame out, the way uart_write() drops a frame that does not
+ * fit. The CSV that comes back must give the samples the decoder can
+ * still recover, in order, and the summary on stderr must count the rest
+ * as lost.
+ *
+ * Build and run on the host, in tools/:
+ *   cc -std=c99 -O2 -o telemetry_decode telemetry_decode.c
+ *   cc -std=c99 -O2 -I../Assignment2/src -I../Lib_MCU/inc \
+ *      -o telemetry_test telemetry_test.c ../Assignment2/src/telemetry.c
+ *   ./telemetry_test [path/to/telemetry_decode]
+ * Exits with 0 when every case passes.
+ */
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+/* popen and pclose */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include "telemetry.h"
+
+/******************************************************************************
+ * Defines and typedefs
+ *****************************************************************************/
+
+#define NUM_SAMPLES 300
+#define KEY_INTERVAL 16
+
+#define CAPTURE     "telemetry_test.bin"
+#define SUMMARY     "telemetry_test.err"
+
+/******************************************************************************
+ * Local variables
+ *****************************************************************************/
+
+static const char *decoder = "./telemetry_decode";
+static uint32_t rnd = 12345;
+
+/******************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+static uint32_t next (uint32_t range)
+{
+    rnd = rnd * 1103515245 + 12345;
+    return (rnd >> 8) % range;
+}
+
+static int32_t clamp (int32_t v, int32_t lo, int32_t hi)
+{
+    return (v < lo) ? lo : (v > hi) ? hi : v;
+}
+
+/*
+ * A 15 s report with sensor noise: random walks on the temperature and
+ * the light, which goes past 65535 lux now and then, jitter on the time
+ * and the axes
+ */
+static void makeSamples (telemetry_sample_t *s, int n, uint16_t firstSeq)
+{
+    int32_t temp = 250;
+    int32_t light = 60000;
+    uint32_t time = 1000;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        temp = clamp(temp + (int32_t)next(21) - 10, -400, 850);
+        light = clamp(light + (int32_t)next(4001) - 2000, 0, 80000);
+        time += 15000 + next(3);
+
+        s[i].seq = (uint16_t)(firstSeq + i);
+        s[i].timestamp = time;
+        s[i].temperature = (int16_t)temp;
+        s[i].light = (uint32_t)light;
+        s[i].x = (int8_t)(next(5) - 2);
+        s[i].y = (int8_t)(next(256) - 128);
+        s[i].z = (int8_t)(64 + next(3) - 1);
+        s[i].warnings = (next(8) == 0) ? (uint8_t)next(4) : 0;
+    }
+}
+
+/* 10 x the CSV temperature, e.g. "-3.5" gives -35 */
+static int32_t parseTenths (const char *str)
+{
+    int neg = (*str == '-');
+    int32_t whole;
+    int32_t tenth;
+
+    if (sscanf(str + neg, "%d.%d", &whole, &tenth) != 2)
+        return 0x7FFFFFFF;
+
+    return neg ? -(whole * 10 + tenth) : whole * 10 + tenth;
+}
+
+/* Returns 0 if the CSV line holds the sample */
+static int compareLine (const char *line, const telemetry_sample_t *s,
+        int delta)
+{
+    unsigned seq, time, light, highTemp, movement;
+    char temp[16];
+    int x, y, z;
+    uint32_t expLight = s->light;
+
+    /* only the fixed frame saturates the light */
+    if (!delta && expLight > 0xFFFF)
+        expLight = 0xFFFF;
+
+    if (sscanf(line, "%u,%u,%15[^,],%u,%d,%d,%d,%u,%u", &seq, &time, temp,
+            &light, &x, &y, &z, &highTemp, &movement) != 9)
+        return -1;
+
+    if (seq != s->seq || time != s->timestamp
+            || parseTenths(temp) != s->temperature
+            || light != expLight
+            || x != s->x || y != s->y || z != s->z
+            || highTemp != (s->warnings & TELEMETRY_WARN_HIGH_TEMP)
+            || movement != ((s->warnings & TELEMETRY_WARN_MOVEMENT) >> 1))
+        return -1;
+
+    return 0;
+}
+
+/*
+ * Run the capture through the decoder, frame drop is not written (-1 for
+ * none). Returns the number of failures.
+ */
+static int runCase (const char *name, const telemetry_sample_t *s, int n,
+        int delta, int drop)
+{
+    static uint8_t keep[NUM_SAMPLES];
+    uint8_t frame[TELEMETRY_DELTA_FRAME_MAX];
+    telemetry_delta_t enc;
+    char cmd[256];
+    char line[128];
+    FILE *f;
+    int status;
+    int i;
+    int k;
+    int kept = 0;
+    int fail = 0;
+    unsigned long good = 0;
+    unsigned long bad = 0;
+    unsigned long lost = 0;
+    uint32_t len;
+
+    f = fopen(CAPTURE, "wb");
+    if (f == NULL) {
+        perror(CAPTURE);
+        exit(1);
+    }
+    telemetry_deltaInit(&enc, KEY_INTERVAL);
+    for (i = 0; i < n; i++) {
+        if (delta)
+            len = telemetry_deltaFrame(&enc, &s[i], frame);
+        else
+            len = telemetry_frame(&s[i], frame);
+        if (i != drop)
+            fwrite(frame, 1, len, f);
+    }
+    fclose(f);
+
+    /* a dropped delta record costs the records up to the next keyframe */
+    for (i = 0; i < n; i++) {
+        keep[i] = (drop < 0 || i < drop
+                || (delta ? i >= (drop / KEY_INTERVAL + 1) * KEY_INTERVAL
+                        : i != drop));
+        kept += keep[i];
+    }
+
+    snprintf(cmd, sizeof(cmd), "%s %s %s 2>%s", decoder,
+            delta ? "-d" : "", CAPTURE, SUMMARY);
+    f = popen(cmd, "r");
+    if (f == NULL) {
+        perror(decoder);
+        exit(1);
+    }
+
+    /* header, then one line per recovered sample */
+    k = -1;
+    i = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (k >= 0) {
+            while (i < n && !keep[i])
+                i++;
+            if (i >= n || compareLine(line, &s[i], delta) != 0) {
+                if (fail++ == 0)
+                    fprintf(stderr, "%s: line %d: %s", name, k + 2, line);
+            }
+            i++;
+        }
+        k++;
+    }
+    status = pclose(f);
+
+    if (k != kept) {
+        fprintf(stderr, "%s: %d samples decoded, %d expected\n",
+                name, k, kept);
+        fail++;
+    }
+
+    f = fopen(SUMMARY, "r");
+    if (f == NULL
+            || fscanf(f, "%lu frames, %lu bad, %lu lost", &good, &bad, &lost) != 3
+            || good != (unsigned long)kept || bad != 0
+            || lost != (unsigned long)(n - kept)) {
+        fprintf(stderr, "%s: summary %lu frames, %lu bad, %lu lost, "
+                "expected %d, 0, %d\n", name, good, bad, lost, kept, n - kept);
+        fail++;
+    }
+    if (f != NULL)
+        fclose(f);
+
+    /* the decoder fails a stream with losses */
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != (kept == n ? 0 : 2)) {
+        fprintf(stderr, "%s: decoder exit status %d\n", name, status);
+        fail++;
+    }
+
+    printf("%-24s %s\n", name, (fail == 0) ? "ok" : "FAILED");
+
+    return fail;
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+
+int main (int argc, char *argv[])
+{
+    static telemetry_sample_t s[NUM_SAMPLES];
+    int fail = 0;
+
+    if (argc > 1)
+        decoder = argv[1];
+
+    makeSamples(s, NUM_SAMPLES, 0);
+    fail += runCase("fixed", s, NUM_SAMPLES, 0, -1);
+    fail += runCase("fixed, frame dropped", s, NUM_SAMPLES, 0, 100);
+    fail += runCase("delta", s, NUM_SAMPLES, 1, -1);
+    fail += runCase("delta, record dropped", s, NUM_SAMPLES, 1, 100);
+    fail += runCase("delta, keyframe dropped", s, NUM_SAMPLES, 1, 160);
+
+    /* seq wraps from 65535 to 0 half way */
+    makeSamples(s, NUM_SAMPLES, (uint16_t)(0x10000 - NUM_SAMPLES / 2));
+    fail += runCase("fixed, seq wrap", s, NUM_SAMPLES, 0, -1);
+    fail += runCase("delta, seq wrap", s, NUM_SAMPLES, 1, -1);
+    fail += runCase("delta, drop at wrap", s, NUM_SAMPLES, 1,
+            NUM_SAMPLES / 2);
+
+    remove(CAPTURE);
+    remove(SUMMARY);
+
+    return (fail == 0) ? 0 : 1;
+}